@@ -0,0 +1,110 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+/**
+ * @brief Bounded lock-free queue (D. Vyukov's array based design).
+ *
+ * Any number of threads may push; pushing never blocks and fails when the
+ * queue is full. Each cell carries a sequence number which tells producers
+ * and consumers whether the cell is free or holds data for the current lap,
+ * so no cell is ever read and written at the same time. Values are moved
+ * in and out of the cells, which are reused for the lifetime of the queue.
+ * The websocket session uses it with many producers (DDS listener threads)
+ * and a single consumer running on the session strand.
+ */
+template <typename T>
+class bounded_queue
+{
+   struct cell {
+      std::atomic<std::size_t> seq;
+      T data;
+   };
+
+   std::unique_ptr<cell[]> buffer_;
+   std::size_t mask_;
+   char pad0_[64];
+   std::atomic<std::size_t> enqueue_pos_;
+   char pad1_[64];
+   std::atomic<std::size_t> dequeue_pos_;
+   char pad2_[64];
+
+public:
+   // capacity is rounded up to the next power of two
+   explicit bounded_queue(std::size_t capacity)
+   {
+      std::size_t size = 2;
+      while (size < capacity) size <<= 1;
+      buffer_.reset(new cell[size]);
+      mask_ = size - 1;
+      for (std::size_t i = 0; i < size; ++i)
+         buffer_[i].seq.store(i, std::memory_order_relaxed);
+      enqueue_pos_.store(0, std::memory_order_relaxed);
+      dequeue_pos_.store(0, std::memory_order_relaxed);
+   }
+
+   bounded_queue(const bounded_queue&) = delete;
+   bounded_queue& operator=(const bounded_queue&) = delete;
+
+   bool try_push(T&& value)
+   {
+      cell* c;
+      std::size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+      for (;;) {
+         c = &buffer_[pos & mask_];
+         std::size_t seq = c->seq.load(std::memory_order_acquire);
+         std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)pos;
+         if (diff == 0) {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+               break;
+         } else if (diff < 0) {
+            return false;   // full
+         } else {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+         }
+      }
+      c->data = std::move(value);
+      c->seq.store(pos + 1, std::memory_order_release);
+      return true;
+   }
+
+   bool try_pop(T& value)
+   {
+      cell* c;
+      std::size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+      for (;;) {
+         c = &buffer_[pos & mask_];
+         std::size_t seq = c->seq.load(std::memory_order_acquire);
+         std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)(pos + 1);
+         if (diff == 0) {
+            if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+               break;
+         } else if (diff < 0) {
+            return false;   // empty
+         } else {
+            pos = dequeue_pos_.load(std::memory_order_relaxed);
+         }
+      }
+      value = std::move(c->data);
+      c->seq.store(pos + mask_ + 1, std::memory_order_release);
+      return true;
+   }
+
+   // approximate while producers or the consumer are active
+   std::size_t size() const
+   {
+      std::size_t head = dequeue_pos_.load(std::memory_order_relaxed);
+      std::size_t tail = enqueue_pos_.load(std::memory_order_relaxed);
+      return tail > head ? tail - head : 0;
+   }
+
+   bool empty() const { return size() == 0; }
+
+   std::size_t capacity() const { return mask_ + 1; }
+};
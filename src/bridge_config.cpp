@@ -0,0 +1,157 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#include "tinyxml2.h"
+
+#include "amm/BaseLogger.h"
+#include "bridge_config.hpp"
+
+namespace {
+   std::string attribute(const tinyxml2::XMLElement* element, const char* name, const char* fallback = "")
+   {
+      const char* value = element->Attribute(name);
+      return value ? value : fallback;
+   }
+}
+
+// Sample configuration
+// <Configuration>
+//    <ROS>
+//       <Endpoint host="10.0.0.195" port="9090"/>
+//       <Endpoint host="10.0.0.196" port="9091" transport="tcp"/>
+//       <Publish topic="/hr/physiology" type="hr_msgs/PhysiologyValue" field="physiologyvalue" batch="false" rate="1">
+//          <Signal name="Cardiovascular_HeartRate"/>
+//          <Signal name="IntracranialPressure" rate="5" deadband="0.5"/>
+//       </Publish>
+//       <Waveforms topic="/hr/waveform" window="50">
+//          <Waveform name="ECG"/>
+//       </Waveforms>
+//       <Event type="connect" topic="/hr/control/speech/say" message_type="hr_msgs/Say">
+//          <Field name="text">MoHSES connected via ros-bridge</Field>
+//       </Event>
+//       <Service event="connect" service="/hr/control/speech/say" type="hr_msgs/TTSTrigger" timeout="2000">
+//          <Arg name="text">MoHSES connected via ros-bridge</Arg>
+//       </Service>
+//       <Subscribe topic="/hr/amm/command" type="std_msgs/String" handler="command" field="data"
+//                  throttle_rate="100" queue_length="1" fragment_size="1000"/>
+//       <Modification type="AirwayObstruction" topic="/hr/amm/airway_obstruction" message_type="hr_msgs/AirwayObstruction">
+//          <Param element="Severity" field="severity" kind="number" default="0"/>
+//       </Modification>
+//    </ROS>
+// </Configuration>
+bool bridge_config::parse(const std::string& xml)
+{
+   tinyxml2::XMLDocument doc;
+   doc.Parse(xml.c_str());
+   if (doc.ErrorID() != 0) {
+      LOG_ERROR << "Configuration parsing error, ID: " << doc.ErrorID();
+      return false;
+   }
+
+   const tinyxml2::XMLElement* pRoot = doc.FirstChildElement("Configuration");
+   const tinyxml2::XMLElement* pRos = pRoot ? pRoot->FirstChildElement("ROS") : nullptr;
+   if (!pRos) return true;   // no ROS mapping, keep defaults
+
+   endpoints.clear();
+   for (const tinyxml2::XMLElement* e = pRos->FirstChildElement("Endpoint"); e; e = e->NextSiblingElement("Endpoint")) {
+      endpoint_mapping mapping;
+      mapping.host = attribute(e, "host");
+      mapping.port = attribute(e, "port", "9090");
+      mapping.transport = attribute(e, "transport");
+      if (!mapping.host.empty()) endpoints.push_back(mapping);
+   }
+
+   publish.clear();
+   for (const tinyxml2::XMLElement* p = pRos->FirstChildElement("Publish"); p; p = p->NextSiblingElement("Publish")) {
+      publish_mapping mapping;
+      mapping.topic = attribute(p, "topic", "/hr/physiology");
+      mapping.type = attribute(p, "type");
+      mapping.batch = p->BoolAttribute("batch", false);
+      mapping.field = attribute(p, "field", mapping.batch ? "physiologyvalues" : "physiologyvalue");
+      mapping.rate = p->DoubleAttribute("rate", 1.0);
+      for (const tinyxml2::XMLElement* s = p->FirstChildElement("Signal"); s; s = s->NextSiblingElement("Signal")) {
+         signal_mapping signal;
+         signal.name = attribute(s, "name");
+         signal.rate = s->DoubleAttribute("rate", mapping.rate);
+         signal.deadband = s->DoubleAttribute("deadband", 0.0);
+         if (!signal.name.empty()) mapping.signals.push_back(signal);
+      }
+      publish.push_back(mapping);
+   }
+
+   const tinyxml2::XMLElement* w = pRos->FirstChildElement("Waveforms");
+   if (w) {
+      waveforms.topic = attribute(w, "topic", "/hr/waveform");
+      waveforms.type = attribute(w, "type");
+      waveforms.window = w->IntAttribute("window", 50);
+      waveforms.names.clear();
+      for (const tinyxml2::XMLElement* s = w->FirstChildElement("Waveform"); s; s = s->NextSiblingElement("Waveform")) {
+         std::string name = attribute(s, "name");
+         if (!name.empty()) waveforms.names.push_back(name);
+      }
+   }
+
+   events.clear();
+   for (const tinyxml2::XMLElement* e = pRos->FirstChildElement("Event"); e; e = e->NextSiblingElement("Event")) {
+      event_mapping mapping;
+      mapping.type = attribute(e, "type");
+      mapping.topic = attribute(e, "topic");
+      mapping.message_type = attribute(e, "message_type");
+      for (const tinyxml2::XMLElement* f = e->FirstChildElement("Field"); f; f = f->NextSiblingElement("Field")) {
+         const char* text = f->GetText();
+         mapping.fields.emplace_back(attribute(f, "name"), text ? text : "");
+      }
+      if (!mapping.type.empty() && !mapping.topic.empty()) events.push_back(mapping);
+   }
+
+   services.clear();
+   for (const tinyxml2::XMLElement* s = pRos->FirstChildElement("Service"); s; s = s->NextSiblingElement("Service")) {
+      service_mapping mapping;
+      mapping.event = attribute(s, "event");
+      mapping.service = attribute(s, "service");
+      mapping.type = attribute(s, "type");
+      mapping.timeout = s->IntAttribute("timeout", 5000);
+      for (const tinyxml2::XMLElement* a = s->FirstChildElement("Arg"); a; a = a->NextSiblingElement("Arg")) {
+         const char* text = a->GetText();
+         mapping.args.emplace_back(attribute(a, "name"), text ? text : "");
+      }
+      if (!mapping.event.empty() && !mapping.service.empty()) services.push_back(mapping);
+   }
+
+   subscribe.clear();
+   for (const tinyxml2::XMLElement* s = pRos->FirstChildElement("Subscribe"); s; s = s->NextSiblingElement("Subscribe")) {
+      subscription_mapping mapping;
+      mapping.topic = attribute(s, "topic");
+      mapping.type = attribute(s, "type");
+      mapping.handler = attribute(s, "handler");
+      mapping.field = attribute(s, "field", "data");
+      mapping.render_type = attribute(s, "render_type");
+      mapping.throttle_rate = s->IntAttribute("throttle_rate", 0);
+      mapping.queue_length = s->IntAttribute("queue_length", 0);
+      mapping.fragment_size = s->IntAttribute("fragment_size", 0);
+      if (mapping.handler != "command" && mapping.handler != "render_modification") {
+         LOG_WARNING << "Ignoring subscription to " << mapping.topic << ", unknown handler \"" << mapping.handler << "\"";
+         continue;
+      }
+      if (!mapping.topic.empty()) subscribe.push_back(mapping);
+   }
+
+   modifications.clear();
+   for (const tinyxml2::XMLElement* m = pRos->FirstChildElement("Modification"); m; m = m->NextSiblingElement("Modification")) {
+      modification_mapping mapping;
+      mapping.type = attribute(m, "type");
+      mapping.topic = attribute(m, "topic");
+      mapping.message_type = attribute(m, "message_type");
+      for (const tinyxml2::XMLElement* p = m->FirstChildElement("Param"); p; p = p->NextSiblingElement("Param")) {
+         modification_param param;
+         param.element = attribute(p, "element");
+         param.field = attribute(p, "field");
+         if (param.field.empty()) param.field = param.element;
+         param.text = attribute(p, "kind", "number") == "text";
+         param.fallback = attribute(p, "default");
+         if (!param.element.empty()) mapping.params.push_back(param);
+      }
+      if (!mapping.type.empty() && !mapping.topic.empty()) modifications.push_back(mapping);
+   }
+   return true;
+}
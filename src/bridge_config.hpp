@@ -0,0 +1,141 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Phys value forwarded at rate publishes per second. With a deadband
+ * it is only published when it changed by at least deadband since it was
+ * last published.
+ */
+struct signal_mapping {
+   std::string name;
+   double rate = 1.0;
+   double deadband = 0.0;
+};
+
+/**
+ * @brief Phys values forwarded to one ROS topic
+ *
+ * batch: all signals in one message {field: [{name, value, unit, sim_time}, ...]}
+ * published at rate, otherwise one message per signal {field: {name, value}}
+ * published at the signal rate. type: ROS message type the topic is
+ * advertised with, not advertised if empty.
+ */
+struct publish_mapping {
+   std::string topic;
+   std::string type;
+   std::string field;
+   bool batch = false;
+   double rate = 1.0;
+   std::vector<signal_mapping> signals;
+};
+
+/**
+ * @brief Waveforms forwarded in chunks of window ms
+ */
+struct waveform_mapping {
+   std::string topic = "/hr/waveform";
+   std::string type;
+   int window = 50;
+   std::vector<std::string> names;
+};
+
+/**
+ * @brief Constant message published to a ROS topic when an event occurs:
+ * "connect" after the websocket handshake, "run", "halt" or "reset" on
+ * AMM simulation control
+ */
+struct event_mapping {
+   std::string type;
+   std::string topic;
+   std::string message_type;
+   std::vector<std::pair<std::string, std::string>> fields;
+};
+
+/**
+ * @brief ROS service called with constant args when an event occurs:
+ * "connect" after the websocket handshake, "run", "halt" or "reset" on
+ * AMM simulation control. type: service type, left out if empty. The call
+ * fails if there is no response within timeout ms.
+ */
+struct service_mapping {
+   std::string event;
+   std::string service;
+   std::string type;
+   int timeout = 5000;
+   std::vector<std::pair<std::string, std::string>> args;
+};
+
+/**
+ * @brief ROS topic subscribed to and forwarded to AMM
+ *
+ * handler: "command" publishes the msg field as an AMM Command,
+ * "render_modification" as the data of an AMM RenderModification of render_type.
+ * throttle_rate (ms), queue_length and fragment_size are passed to
+ * rosbridge with the subscribe op when set.
+ */
+struct subscription_mapping {
+   std::string topic;
+   std::string type;
+   std::string handler;
+   std::string field = "data";
+   std::string render_type;
+   int throttle_rate = 0;
+   int queue_length = 0;
+   int fragment_size = 0;
+};
+
+/**
+ * @brief Element of a physiology modification payload copied to a field of
+ * the ROS message. text: copied as string, otherwise as number. fallback is
+ * used when the payload has no such element.
+ */
+struct modification_param {
+   std::string element;
+   std::string field;
+   bool text = false;
+   std::string fallback;
+};
+
+/**
+ * @brief Physiology modification type forwarded to a ROS topic as
+ * {"type": type, field: value, ...}
+ */
+struct modification_mapping {
+   std::string type;
+   std::string topic;
+   std::string message_type;
+   std::vector<modification_param> params;
+};
+
+/**
+ * @brief Rosbridge server the bridge connects to. transport: "websocket"
+ * (rosbridge_websocket) or "tcp" (rosbridge_tcp), websocket if empty.
+ */
+struct endpoint_mapping {
+   std::string host;
+   std::string port = "9090";
+   std::string transport;
+};
+
+/**
+ * @brief Bridge_Config holds the AMM to ROS mapping read from the <ROS>
+ * section of config/ros_bridge_configuration.xml
+ */
+struct bridge_config {
+   std::vector<publish_mapping> publish;
+   waveform_mapping waveforms;
+   std::vector<event_mapping> events;
+   std::vector<service_mapping> services;
+   std::vector<subscription_mapping> subscribe;
+   std::vector<modification_mapping> modifications;
+   std::vector<endpoint_mapping> endpoints;
+
+   // parse the configuration document. Returns false if it can not be parsed.
+   bool parse(const std::string& xml);
+};
@@ -0,0 +1,133 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#include <cmath>
+#include <cstdio>
+
+#include "amm/BaseLogger.h"
+#include "bridge_metrics.hpp"
+
+namespace {
+
+void append_value(std::string& out, double value)
+{
+   char text[32];
+   int n;
+   if (std::isnan(value)) n = snprintf(text, sizeof(text), "NaN");
+   else if (std::isinf(value)) n = snprintf(text, sizeof(text), value > 0 ? "+Inf" : "-Inf");
+   else n = snprintf(text, sizeof(text), "%.15g", value);
+   out.append(text, n);
+}
+
+void append_line(std::string& out, const std::string& name, const char* suffix, const std::string& labels, double value)
+{
+   out += name;
+   out += suffix;
+   if (!labels.empty()) {
+      out += '{';
+      out += labels;
+      out += '}';
+   }
+   out += ' ';
+   append_value(out, value);
+   out += '\n';
+}
+
+}
+
+bridge_metrics::bridge_metrics(std::size_t capacity)
+   : values_(new std::atomic<uint64_t>[capacity + 2])
+   , capacity_(capacity + 2)
+{
+   for (std::size_t i = 0; i < capacity_; ++i)
+      values_[i].store(0, std::memory_order_relaxed);
+}
+
+bridge_metrics::counter_id bridge_metrics::allocate(std::size_t count, const std::string& name)
+{
+   if (used_ + count > capacity_) {
+      LOG_WARNING << "Too many metrics, not counting " << name;
+      return 0;
+   }
+   counter_id id = used_;
+   used_ += count;
+   return id;
+}
+
+void bridge_metrics::add_series(const std::string& name, const std::string& help, const char* type, series s)
+{
+   for (family& f : families_) {
+      if (f.name != name) continue;
+      f.members.push_back(std::move(s));
+      return;
+   }
+   families_.push_back(family{name, help, type, {}});
+   families_.back().members.push_back(std::move(s));
+}
+
+bridge_metrics::counter_id bridge_metrics::counter(const std::string& name, const std::string& help,
+                                                   const std::string& labels)
+{
+   counter_id id = allocate(1, name);
+   if (id != 0) add_series(name, help, "counter", series{labels, owned, id, reader()});
+   return id;
+}
+
+bridge_metrics::counter_id bridge_metrics::duration(const std::string& name, const std::string& help,
+                                                    const std::string& labels)
+{
+   counter_id id = allocate(2, name);
+   if (id != 0) add_series(name, help, "summary", series{labels, owned_duration, id, reader()});
+   return id;
+}
+
+void bridge_metrics::counter(const std::string& name, const std::string& help, const std::string& labels, reader read)
+{
+   add_series(name, help, "counter", series{labels, external, 0, std::move(read)});
+}
+
+void bridge_metrics::gauge(const std::string& name, const std::string& help, const std::string& labels, reader read)
+{
+   add_series(name, help, "gauge", series{labels, external, 0, std::move(read)});
+}
+
+void bridge_metrics::render(std::string& out) const
+{
+   for (const family& f : families_) {
+      out += "# HELP ";
+      out += f.name;
+      out += ' ';
+      out += f.help;
+      out += "\n# TYPE ";
+      out += f.name;
+      out += ' ';
+      out += f.type;
+      out += '\n';
+      for (const series& s : f.members) {
+         switch (s.type) {
+            case owned :
+               append_line(out, f.name, "", s.labels, (double)value(s.id));
+               break;
+            case owned_duration :
+               append_line(out, f.name, "_sum", s.labels, value(s.id) * 1e-9);
+               append_line(out, f.name, "_count", s.labels, (double)value(s.id + 1));
+               break;
+            case external :
+               append_line(out, f.name, "", s.labels, s.read());
+               break;
+         }
+      }
+   }
+}
+
+std::string bridge_metrics::label(const std::string& name, const std::string& value)
+{
+   std::string pair = name + "=\"";
+   for (char c : value) {
+      if (c == '\\' || c == '"') pair += '\\';
+      if (c == '\n') { pair += "\\n"; continue; }
+      pair += c;
+   }
+   pair += '"';
+   return pair;
+}
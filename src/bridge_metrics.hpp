@@ -0,0 +1,78 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Bridge_Metrics holds the counters and gauges of the bridge and
+ * renders them in the Prometheus text format.
+ *
+ * Metrics are registered at setup. Counters owned here are atomics, added
+ * to from any thread without locking. Values the bridge already counts
+ * elsewhere (queue stats, pool, service calls, ...) are registered as
+ * readers and read when the metrics are rendered, on the rendering thread.
+ * Series with the same name form one metric family, rendered together
+ * under one HELP and TYPE line.
+ */
+class bridge_metrics
+{
+public:
+   typedef std::size_t counter_id;
+   typedef std::function<double()> reader;
+
+   explicit bridge_metrics(std::size_t capacity = 1024);
+
+   // setup time only. labels: label pairs as built by label(), comma
+   // separated, empty for none.
+   counter_id counter(const std::string& name, const std::string& help, const std::string& labels = "");
+   // durations in seconds, rendered as a summary name_sum, name_count
+   counter_id duration(const std::string& name, const std::string& help, const std::string& labels = "");
+   void counter(const std::string& name, const std::string& help, const std::string& labels, reader read);
+   void gauge(const std::string& name, const std::string& help, const std::string& labels, reader read);
+
+   void add(counter_id id, uint64_t n = 1) { values_[id].fetch_add(n, std::memory_order_relaxed); }
+   void record(counter_id duration, int64_t ns)
+   {
+      add(duration, ns > 0 ? (uint64_t)ns : 0);
+      add(duration + 1);
+   }
+   uint64_t value(counter_id id) const { return values_[id].load(std::memory_order_relaxed); }
+
+   // text exposition format 0.0.4, appended to out
+   void render(std::string& out) const;
+
+   // name="value", the value escaped
+   static std::string label(const std::string& name, const std::string& value);
+
+private:
+   enum kind { owned, owned_duration, external };
+
+   struct series {
+      std::string labels;
+      kind type;
+      counter_id id;
+      reader read;
+   };
+   struct family {
+      std::string name;
+      std::string help;
+      const char* type;
+      std::vector<series> members;
+   };
+
+   std::unique_ptr<std::atomic<uint64_t>[]> values_;
+   std::size_t capacity_;
+   std::size_t used_ = 2;   // 0 and 1 take what did not fit
+   std::vector<family> families_;
+
+   counter_id allocate(std::size_t count, const std::string& name);
+   void add_series(const std::string& name, const std::string& help, const char* type, series s);
+};
@@ -0,0 +1,198 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "amm/BaseLogger.h"
+#include "capture_file.hpp"
+
+namespace {
+
+const char capture_magic[8] = {'A', 'M', 'M', 'C', 'A', 'P', 0, 0};
+const uint32_t capture_version = 1;
+
+std::size_t padded(std::size_t size)
+{
+   return (size + 7) & ~std::size_t(7);
+}
+
+}
+
+capture_writer::~capture_writer()
+{
+   close();
+}
+
+bool capture_writer::open(const std::string& path)
+{
+   close();
+   file_ = std::fopen(path.c_str(), "wb");
+   if (!file_) {
+      LOG_ERROR << "Could not create capture file " << path << ": " << strerror(errno);
+      return false;
+   }
+   capture_header header;
+   std::memset(&header, 0, sizeof(header));
+   std::memcpy(header.magic, capture_magic, sizeof(header.magic));
+   header.version = capture_version;
+   header.wall_start = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+   start_ = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+   buffer_.reserve(flush_size + 4096);
+   full_.reserve(flush_size + 4096);
+   buffer_.insert(buffer_.end(), reinterpret_cast<const char*>(&header), reinterpret_cast<const char*>(&header) + sizeof(header));
+   records_ = 0;
+   stop_ = false;
+   thread_ = std::thread(&capture_writer::run, this);
+   open_ = true;
+   return true;
+}
+
+// the writer thread writes out the rest of the buffer before it returns
+void capture_writer::close()
+{
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!file_ || stop_) return;
+      open_ = false;
+      stop_ = true;
+   }
+   ready_.notify_one();
+   thread_.join();
+   std::lock_guard<std::mutex> lock(mutex_);
+   std::fclose(file_);
+   file_ = nullptr;
+}
+
+void capture_writer::write(capture_record_header::kind type, int64_t timestamp, double value, int64_t frame,
+                           const std::string& name, const std::string& text)
+{
+   capture_record_header record;
+   std::memset(&record, 0, sizeof(record));
+   record.type = type;
+   record.name_length = (uint16_t)std::min<std::size_t>(name.size(), UINT16_MAX);
+   record.text_length = (uint32_t)text.size();
+   record.size = (uint32_t)padded(sizeof(record) + record.name_length + record.text_length);
+   record.value = value;
+   record.frame = frame;
+
+   std::unique_lock<std::mutex> lock(mutex_);
+   if (!file_ || stop_) return;
+   record.timestamp = timestamp - start_;
+   std::size_t offset = buffer_.size();
+   buffer_.resize(offset + record.size);
+   char* out = buffer_.data() + offset;
+   std::memcpy(out, &record, sizeof(record));
+   std::memcpy(out + sizeof(record), name.data(), record.name_length);
+   std::memcpy(out + sizeof(record) + record.name_length, text.data(), record.text_length);
+   std::memset(out + sizeof(record) + record.name_length + record.text_length, 0,
+               record.size - sizeof(record) - record.name_length - record.text_length);
+   ++records_;
+   // hand the buffer over unless the writer thread is still busy with the
+   // previous one
+   if (buffer_.size() >= flush_size && full_.empty()) {
+      buffer_.swap(full_);
+      lock.unlock();
+      ready_.notify_one();
+   }
+}
+
+// writer thread: writes out the handed over buffers until close()
+void capture_writer::run()
+{
+   std::unique_lock<std::mutex> lock(mutex_);
+   for (;;) {
+      ready_.wait(lock, [this]() { return !full_.empty() || stop_; });
+      if (full_.empty()) {
+         if (buffer_.empty()) break;
+         buffer_.swap(full_);
+      }
+      lock.unlock();
+      if (std::fwrite(full_.data(), 1, full_.size(), file_) != full_.size())
+         LOG_ERROR << "Could not write capture file: " << strerror(errno);
+      std::fflush(file_);
+      lock.lock();
+      full_.clear();
+   }
+}
+
+capture_reader::~capture_reader()
+{
+   close();
+}
+
+bool capture_reader::open(const std::string& path)
+{
+   close();
+   int fd = ::open(path.c_str(), O_RDONLY);
+   if (fd < 0) {
+      LOG_ERROR << "Could not open capture file " << path << ": " << strerror(errno);
+      return false;
+   }
+   struct stat st;
+   if (fstat(fd, &st) != 0 || (std::size_t)st.st_size < sizeof(capture_header)) {
+      LOG_ERROR << "Not a capture file: " << path;
+      ::close(fd);
+      return false;
+   }
+   void* map = mmap(nullptr, (std::size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   ::close(fd);
+   if (map == MAP_FAILED) {
+      LOG_ERROR << "Could not map capture file " << path << ": " << strerror(errno);
+      return false;
+   }
+   madvise(map, (std::size_t)st.st_size, MADV_SEQUENTIAL);
+   data_ = static_cast<const char*>(map);
+   size_ = (std::size_t)st.st_size;
+
+   if (std::memcmp(header().magic, capture_magic, sizeof(capture_magic)) != 0 || header().version != capture_version) {
+      LOG_ERROR << "Not a capture file or unsupported version: " << path;
+      close();
+      return false;
+   }
+   rewind();
+   return true;
+}
+
+void capture_reader::close()
+{
+   if (data_) munmap(const_cast<char*>(data_), size_);
+   data_ = nullptr;
+   size_ = 0;
+   offset_ = 0;
+}
+
+void capture_reader::rewind()
+{
+   offset_ = sizeof(capture_header);
+}
+
+bool capture_reader::next(capture_record& record)
+{
+   if (!data_ || size_ - offset_ < sizeof(capture_record_header)) return false;
+   capture_record_header header;
+   std::memcpy(&header, data_ + offset_, sizeof(header));
+   if (header.size < sizeof(header) + header.name_length + header.text_length || header.size > size_ - offset_)
+      return false;
+
+   const char* payload = data_ + offset_ + sizeof(header);
+   record.type = header.type;
+   record.timestamp = header.timestamp;
+   record.value = header.value;
+   record.frame = header.frame;
+   record.name = payload;
+   record.name_length = header.name_length;
+   record.text = payload + header.name_length;
+   record.text_length = header.text_length;
+   offset_ += header.size;
+   return true;
+}
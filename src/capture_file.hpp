@@ -0,0 +1,139 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Capture file layout
+ *
+ * A capture file is a capture_header followed by records. Every record is a
+ * capture_record_header followed by name_length bytes of name and
+ * text_length bytes of text, padded to 8 bytes. What name, text, value and
+ * frame hold depends on the record type:
+ *
+ *   phys_value         name, unit, value
+ *   waveform_sample    name, unit, value
+ *   tick               frame
+ *   sim_control        frame: AMM::ControlType
+ *   physiology_mod     name: type, text: data
+ *   render_mod         name: type, text: data
+ *
+ * Timestamps are steady clock ns since the start of the capture. Records are
+ * only appended, a capture cut short by a crash is read up to its last
+ * complete record.
+ */
+struct capture_header {
+   char magic[8];            // "AMMCAP\0\0"
+   uint32_t version;
+   uint32_t reserved;
+   int64_t wall_start;       // system clock ns at the start of the capture
+};
+
+struct capture_record_header {
+   enum kind : uint8_t {
+      phys_value = 1,
+      waveform_sample,
+      tick,
+      sim_control,
+      physiology_mod,
+      render_mod,
+   };
+   uint32_t size;            // whole record including padding
+   kind type;
+   uint8_t reserved;
+   uint16_t name_length;
+   uint32_t text_length;
+   uint32_t reserved2;
+   int64_t timestamp;
+   double value;
+   int64_t frame;
+};
+
+/**
+ * @brief Record of a capture file. name and text point into the mapped file.
+ */
+struct capture_record {
+   capture_record_header::kind type;
+   int64_t timestamp;
+   double value;
+   int64_t frame;
+   const char* name;
+   std::size_t name_length;
+   const char* text;
+   std::size_t text_length;
+};
+
+/**
+ * @brief Capture_Writer appends received AMM samples to a capture file.
+ *
+ * May be called from all DDS listener threads. Records are copied into a
+ * buffer under a mutex; full buffers are handed to a writer thread, the
+ * only one that writes to the file. A listener thread never waits for the
+ * disk: while the writer is busy the buffer keeps growing.
+ */
+class capture_writer
+{
+public:
+   capture_writer() = default;
+   ~capture_writer();
+
+   bool open(const std::string& path);
+   bool is_open() const { return open_; }
+   void close();
+
+   void write(capture_record_header::kind type, int64_t timestamp, double value, int64_t frame,
+              const std::string& name = std::string(), const std::string& text = std::string());
+
+   uint64_t records() const { return records_; }
+
+private:
+   static const std::size_t flush_size = 64 * 1024;
+
+   std::mutex mutex_;
+   std::condition_variable ready_;
+   std::FILE* file_ = nullptr;
+   std::atomic<bool> open_{false};
+   bool stop_ = false;
+   std::vector<char> buffer_;   // filled by write()
+   std::vector<char> full_;     // written out by the writer thread, empty when it is idle
+   std::thread thread_;
+   int64_t start_ = 0;
+   uint64_t records_ = 0;
+
+   void run();
+};
+
+/**
+ * @brief Capture_Reader maps a capture file and iterates over its records.
+ */
+class capture_reader
+{
+public:
+   capture_reader() = default;
+   ~capture_reader();
+   capture_reader(const capture_reader&) = delete;
+   capture_reader& operator=(const capture_reader&) = delete;
+
+   bool open(const std::string& path);
+   void close();
+
+   const capture_header& header() const { return *reinterpret_cast<const capture_header*>(data_); }
+
+   // next record, false at the end of the file or at a truncated record
+   bool next(capture_record& record);
+   void rewind();
+
+private:
+   const char* data_ = nullptr;
+   std::size_t size_ = 0;
+   std::size_t offset_ = 0;
+};
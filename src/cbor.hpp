@@ -0,0 +1,312 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+/**
+ * @brief Cbor_Writer encodes a message as CBOR (RFC 8949).
+ *
+ * It has the same interface as a rapidjson Writer, so a message serializer
+ * written against that interface produces either JSON or CBOR. Maps and
+ * arrays use indefinite length encoding, which keeps the writer a single
+ * pass. Doubles that fit a float without loss are written as floats.
+ */
+class cbor_writer
+{
+   std::string& out_;
+
+   void head(uint8_t major, uint64_t value)
+   {
+      major <<= 5;
+      if (value < 24) {
+         out_ += (char)(major | value);
+      } else if (value <= 0xff) {
+         out_ += (char)(major | 24);
+         out_ += (char)value;
+      } else if (value <= 0xffff) {
+         out_ += (char)(major | 25);
+         put_be(value, 2);
+      } else if (value <= 0xffffffffULL) {
+         out_ += (char)(major | 26);
+         put_be(value, 4);
+      } else {
+         out_ += (char)(major | 27);
+         put_be(value, 8);
+      }
+   }
+
+   void put_be(uint64_t value, int bytes)
+   {
+      for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8)
+         out_ += (char)((value >> shift) & 0xff);
+   }
+
+public:
+   typedef char Ch;
+
+   explicit cbor_writer(std::string& out) : out_(out) {}
+
+   bool Null() { out_ += '\xf6'; return true; }
+   bool Bool(bool b) { out_ += b ? '\xf5' : '\xf4'; return true; }
+   bool Int(int i) { return Int64(i); }
+   bool Uint(unsigned u) { return Uint64(u); }
+   bool Uint64(uint64_t u) { head(0, u); return true; }
+
+   bool Int64(int64_t i)
+   {
+      if (i < 0) head(1, (uint64_t)(-(i + 1)));
+      else head(0, (uint64_t)i);
+      return true;
+   }
+
+   bool Double(double d)
+   {
+      float f = (float)d;
+      if ((double)f == d || std::isnan(d)) {
+         uint32_t bits;
+         std::memcpy(&bits, &f, sizeof(bits));
+         out_ += '\xfa';
+         put_be(bits, 4);
+      } else {
+         uint64_t bits;
+         std::memcpy(&bits, &d, sizeof(bits));
+         out_ += '\xfb';
+         put_be(bits, 8);
+      }
+      return true;
+   }
+
+   bool RawNumber(const Ch* str, unsigned length, bool /*copy*/ = false)
+   {
+      return Double(std::strtod(std::string(str, length).c_str(), nullptr));
+   }
+
+   bool String(const Ch* str, unsigned length, bool /*copy*/ = false)
+   {
+      head(3, length);
+      out_.append(str, length);
+      return true;
+   }
+
+   bool String(const Ch* str) { return String(str, (unsigned)std::strlen(str)); }
+   bool Key(const Ch* str, unsigned length, bool /*copy*/ = false) { return String(str, length); }
+   bool Key(const Ch* str) { return String(str); }
+
+   bool StartObject() { out_ += '\xbf'; return true; }
+   bool EndObject(unsigned /*count*/ = 0) { out_ += '\xff'; return true; }
+   bool StartArray() { out_ += '\x9f'; return true; }
+   bool EndArray(unsigned /*count*/ = 0) { out_ += '\xff'; return true; }
+};
+
+/**
+ * @brief Cbor_Reader decodes one CBOR item and reports it to a rapidjson
+ * SAX handler, e.g. a Document (via Populate) or a custom handler.
+ *
+ * Text strings are handed to the handler as pointers into the input. Byte
+ * strings become arrays of numbers, tags are skipped, integer map keys are
+ * converted to text. Returns false for malformed input, input nested deeper
+ * than max_depth, or when the handler stops the parse.
+ */
+template <typename Handler>
+class cbor_reader
+{
+   static const int max_depth = 64;
+
+   const uint8_t* p_;
+   const uint8_t* end_;
+   Handler& handler_;
+
+   bool read_be(int bytes, uint64_t& value)
+   {
+      if (end_ - p_ < bytes) return false;
+      value = 0;
+      for (int i = 0; i < bytes; ++i) value = (value << 8) | *p_++;
+      return true;
+   }
+
+   // read the argument of an item head. additional info 31 (indefinite)
+   // is reported with indefinite set.
+   bool argument(uint8_t info, uint64_t& value, bool& indefinite)
+   {
+      indefinite = false;
+      if (info < 24) { value = info; return true; }
+      switch (info) {
+         case 24: return read_be(1, value);
+         case 25: return read_be(2, value);
+         case 26: return read_be(4, value);
+         case 27: return read_be(8, value);
+         case 31: indefinite = true; value = 0; return true;
+         default: return false;
+      }
+   }
+
+   static double half_to_double(uint16_t half)
+   {
+      int exp = (half >> 10) & 0x1f;
+      int mant = half & 0x3ff;
+      double value;
+      if (exp == 0) value = std::ldexp(mant, -24);
+      else if (exp != 31) value = std::ldexp(mant + 1024, exp - 25);
+      else value = mant == 0 ? INFINITY : NAN;
+      return (half & 0x8000) ? -value : value;
+   }
+
+   bool at_break()
+   {
+      if (p_ < end_ && *p_ == 0xff) { ++p_; return true; }
+      return false;
+   }
+
+   // text or byte string made of indefinite length chunks
+   bool read_chunks(uint8_t major, std::string& out)
+   {
+      while (!at_break()) {
+         if (p_ >= end_ || (*p_ >> 5) != major) return false;
+         uint64_t length;
+         bool indefinite;
+         if (!argument(*p_++ & 0x1f, length, indefinite) || indefinite) return false;
+         if ((uint64_t)(end_ - p_) < length) return false;
+         out.append((const char*)p_, length);
+         p_ += length;
+      }
+      return true;
+   }
+
+   bool bytes(const uint8_t* data, std::size_t length)
+   {
+      if (!handler_.StartArray()) return false;
+      for (std::size_t i = 0; i < length; ++i)
+         if (!handler_.Uint(data[i])) return false;
+      return handler_.EndArray((unsigned)length);
+   }
+
+   bool key()
+   {
+      if (p_ >= end_) return false;
+      uint8_t major = *p_ >> 5;
+      if (major == 3) {
+         uint8_t info = *p_++ & 0x1f;
+         uint64_t length;
+         bool indefinite;
+         if (!argument(info, length, indefinite)) return false;
+         if (indefinite) {
+            std::string text;
+            return read_chunks(3, text) && handler_.Key(text.data(), (unsigned)text.size(), true);
+         }
+         if ((uint64_t)(end_ - p_) < length) return false;
+         const char* text = (const char*)p_;
+         p_ += length;
+         return handler_.Key(text, (unsigned)length, true);
+      }
+      if (major == 0 || major == 1) {
+         uint64_t value;
+         bool indefinite;
+         if (!argument(*p_++ & 0x1f, value, indefinite) || indefinite) return false;
+         std::string text = major == 0 ? std::to_string(value) : std::to_string(-1 - (int64_t)value);
+         return handler_.Key(text.data(), (unsigned)text.size(), true);
+      }
+      return false;
+   }
+
+   bool item(int depth)
+   {
+      if (depth > max_depth || p_ >= end_) return false;
+      uint8_t major = *p_ >> 5;
+      uint8_t info = *p_++ & 0x1f;
+      uint64_t value;
+      bool indefinite;
+
+      if (major == 7) {
+         switch (info) {
+            case 20: return handler_.Bool(false);
+            case 21: return handler_.Bool(true);
+            case 22:
+            case 23: return handler_.Null();
+            case 25: {
+               if (!read_be(2, value)) return false;
+               return handler_.Double(half_to_double((uint16_t)value));
+            }
+            case 26: {
+               if (!read_be(4, value)) return false;
+               uint32_t bits = (uint32_t)value;
+               float f;
+               std::memcpy(&f, &bits, sizeof(f));
+               return handler_.Double(f);
+            }
+            case 27: {
+               if (!read_be(8, value)) return false;
+               double d;
+               std::memcpy(&d, &value, sizeof(d));
+               return handler_.Double(d);
+            }
+            default: return false;
+         }
+      }
+
+      if (!argument(info, value, indefinite)) return false;
+      switch (major) {
+         case 0:
+            return handler_.Uint64(value);
+         case 1:
+            if (value > (uint64_t)INT64_MAX) return handler_.Double(-1.0 - (double)value);
+            return handler_.Int64(-1 - (int64_t)value);
+         case 2:
+         case 3: {
+            if (indefinite) {
+               std::string data;
+               if (!read_chunks(major, data)) return false;
+               if (major == 2) return bytes((const uint8_t*)data.data(), data.size());
+               return handler_.String(data.data(), (unsigned)data.size(), true);
+            }
+            if ((uint64_t)(end_ - p_) < value) return false;
+            const uint8_t* data = p_;
+            p_ += value;
+            if (major == 2) return bytes(data, value);
+            return handler_.String((const char*)data, (unsigned)value, true);
+         }
+         case 4: {
+            if (!handler_.StartArray()) return false;
+            unsigned count = 0;
+            for (; indefinite ? !at_break() : count < value; ++count)
+               if (!item(depth + 1)) return false;
+            return handler_.EndArray(count);
+         }
+         case 5: {
+            if (!handler_.StartObject()) return false;
+            unsigned count = 0;
+            for (; indefinite ? !at_break() : count < value; ++count)
+               if (!key() || !item(depth + 1)) return false;
+            return handler_.EndObject(count);
+         }
+         case 6:
+            // tag: the tagged item is reported as is. A tag counts as a
+            // level, so a chain of tags is bounded like nested arrays.
+            return !indefinite && item(depth + 1);
+      }
+      return false;
+   }
+
+public:
+   cbor_reader(const void* data, std::size_t size, Handler& handler)
+      : p_((const uint8_t*)data)
+      , end_((const uint8_t*)data + size)
+      , handler_(handler)
+   {
+   }
+
+   bool parse() { return item(0); }
+};
+
+// decode one CBOR item from data, reporting it to handler
+template <typename Handler>
+bool cbor_parse(const void* data, std::size_t size, Handler& handler)
+{
+   cbor_reader<Handler> reader(data, size, handler);
+   return reader.parse();
+}
@@ -1,11 +1,40 @@
 
 #include <argp.h>
+#include <stdlib.h>
+#include <string.h>
 
 struct arguments {
    char *hostname;
    char *port;
+   char *signals;
+   char *queue_policy;
+   int queue_depth;
+   char *waveforms;
+   int waveform_window;
+   char *encoding;
+   bool deflate;
+   int deflate_window;
+   int deflate_level;
+   int deflate_threshold;
+   int fragment_size;
+   char *transport;
+   bool nagle;
+   int send_buffer;
+   int receive_buffer;
+   int keep_alive;
+   int reconnect_min;
+   int reconnect_max;
+   int io_cpu;
+   int service_limit;
+   int metrics_port;
+   char *metrics_address;
+   int status_interval;
+   char *capture;
+   char *replay;
+   double replay_speed;
    bool verbose;
    bool autostart;
+   bool batch;
 } arguments;
 
 // set up command line option checking using argp.h
@@ -15,12 +44,67 @@ const char *argp_program_bug_address = "<rainer@uw.edu>";
 static char doc[] = 
     "Bridge module for data exchange between MoHSES and a ROS instance.";
 
+// keys for long-only options
+enum {
+   OPT_QUEUE_DEPTH = 1000,
+   OPT_QUEUE_POLICY,
+   OPT_WAVEFORM_WINDOW,
+   OPT_ENCODING,
+   OPT_DEFLATE,
+   OPT_DEFLATE_WINDOW,
+   OPT_DEFLATE_LEVEL,
+   OPT_DEFLATE_THRESHOLD,
+   OPT_FRAGMENT_SIZE,
+   OPT_RECONNECT_MIN,
+   OPT_RECONNECT_MAX,
+   OPT_IO_CPU,
+   OPT_CAPTURE,
+   OPT_REPLAY,
+   OPT_REPLAY_SPEED,
+   OPT_SERVICE_LIMIT,
+   OPT_METRICS_PORT,
+   OPT_METRICS_ADDRESS,
+   OPT_STATUS_INTERVAL,
+   OPT_TRANSPORT,
+   OPT_NAGLE,
+   OPT_SEND_BUFFER,
+   OPT_RECEIVE_BUFFER,
+   OPT_KEEP_ALIVE,
+};
+
 static char args_doc[] = "";
 static struct argp_option options[] = {
-    { "host",  'h', "HOST", 0, "Host IP address"},
-    { "port",  'p', "PORT", 0, "Host port"},
+    { "host",  'h', "HOSTS", 0, "Host IP address, or comma separated list of HOST[:PORT] to send to several ROS instances"},
+    { "port",  'p', "PORT", 0, "Host port, unless given with the host"},
     { "autostart",'a', 0, 0, "Autostart monitor"},
+    { "batch",  'b', 0, 0, "Send all selected phys values in one message"},
+    { "signals",'s', "LIST", 0, "Comma separated list of phys values to forward"},
     { "verbose",  'v', 0, 0, "Print extra data"},
+    { "waveforms",'w', "LIST", 0, "Comma separated list of waveforms to forward"},
+    { "waveform-window", OPT_WAVEFORM_WINDOW, "MS", 0, "Length of forwarded waveform chunks in ms (default 50)"},
+    { "encoding", OPT_ENCODING, "ENC", 0, "Message encoding: json (text frames) or cbor (binary frames)"},
+    { "deflate", OPT_DEFLATE, 0, 0, "Enable permessage-deflate compression"},
+    { "deflate-window", OPT_DEFLATE_WINDOW, "BITS", 0, "Deflate window size, 9..15 bits"},
+    { "deflate-level", OPT_DEFLATE_LEVEL, "LEVEL", 0, "Deflate compression level, 0..9"},
+    { "deflate-threshold", OPT_DEFLATE_THRESHOLD, "BYTES", 0, "Only compress messages of at least this size"},
+    { "fragment-size", OPT_FRAGMENT_SIZE, "BYTES", 0, "Send json messages larger than this as rosbridge fragments (default 0, never)"},
+    { "transport", OPT_TRANSPORT, "TRANSPORT", 0, "websocket (rosbridge_websocket) or tcp (rosbridge_tcp, json only) for all ROS instances"},
+    { "nagle", OPT_NAGLE, 0, 0, "Leave Nagle's algorithm on, TCP_NODELAY is set by default"},
+    { "send-buffer", OPT_SEND_BUFFER, "BYTES", 0, "Socket send buffer size (default: system)"},
+    { "receive-buffer", OPT_RECEIVE_BUFFER, "BYTES", 0, "Socket receive buffer size (default: system)"},
+    { "keepalive", OPT_KEEP_ALIVE, "S", 0, "Send TCP keepalive probes after S idle seconds (default 0, off)"},
+    { "queue-depth", OPT_QUEUE_DEPTH, "N", 0, "Max. number of messages queued for ROS"},
+    { "reconnect-min", OPT_RECONNECT_MIN, "MS", 0, "First reconnect delay in ms, doubled after each failed attempt (default 25)"},
+    { "reconnect-max", OPT_RECONNECT_MAX, "MS", 0, "Longest reconnect delay in ms (default 5000)"},
+    { "service-limit", OPT_SERVICE_LIMIT, "N", 0, "Max. number of ROS service calls waiting for their response (default 16, 0 no limit)"},
+    { "metrics-port", OPT_METRICS_PORT, "PORT", 0, "Serve counters in Prometheus text format on http://ADDRESS:PORT/metrics (default 0, off)"},
+    { "metrics-address", OPT_METRICS_ADDRESS, "ADDRESS", 0, "Address the metrics endpoint listens on (default 127.0.0.1)"},
+    { "status-interval", OPT_STATUS_INTERVAL, "S", 0, "Publish a summary of the counters on the AMM Status topic every S seconds (default 10, 0 never)"},
+    { "io-cpu", OPT_IO_CPU, "CPU", 0, "Pin the I/O thread to this CPU"},
+    { "capture", OPT_CAPTURE, "FILE", 0, "Record all received AMM samples to a capture file"},
+    { "replay", OPT_REPLAY, "FILE", 0, "Replay a capture file instead of subscribing to AMM"},
+    { "replay-speed", OPT_REPLAY_SPEED, "X", 0, "Replay speed, 1 real time (default), N times faster, 0 as fast as possible"},
+    { "queue-policy", OPT_QUEUE_POLICY, "POLICY", 0, "When the queue is full: oldest (drop oldest), newest (drop newest) or block (wait up to 1 s; drops newest on the I/O thread)"},
     { 0 }
 };
 
@@ -37,9 +121,128 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state) {
       case 'a':
          arguments->autostart = true;
          break;
+      case 'b':
+         arguments->batch = true;
+         break;
+      case 's':
+         arguments->signals = arg;
+         break;
       case 'v':
          arguments->verbose = true;
          break;
+      case 'w':
+         arguments->waveforms = arg;
+         break;
+      case OPT_WAVEFORM_WINDOW:
+         arguments->waveform_window = atoi(arg);
+         if (arguments->waveform_window <= 0)
+            argp_error(state, "invalid waveform window: %s", arg);
+         break;
+      case OPT_ENCODING:
+         if (strcmp(arg, "json") && strcmp(arg, "cbor"))
+            argp_error(state, "invalid encoding: %s", arg);
+         arguments->encoding = arg;
+         break;
+      case OPT_DEFLATE:
+         arguments->deflate = true;
+         break;
+      case OPT_DEFLATE_WINDOW:
+         arguments->deflate_window = atoi(arg);
+         if (arguments->deflate_window < 9 || arguments->deflate_window > 15)
+            argp_error(state, "invalid deflate window: %s", arg);
+         break;
+      case OPT_DEFLATE_LEVEL:
+         arguments->deflate_level = atoi(arg);
+         if (arguments->deflate_level < 0 || arguments->deflate_level > 9)
+            argp_error(state, "invalid deflate level: %s", arg);
+         break;
+      case OPT_DEFLATE_THRESHOLD:
+         arguments->deflate_threshold = atoi(arg);
+         if (arguments->deflate_threshold < 0)
+            argp_error(state, "invalid deflate threshold: %s", arg);
+         break;
+      case OPT_FRAGMENT_SIZE:
+         arguments->fragment_size = atoi(arg);
+         if (arguments->fragment_size < 0)
+            argp_error(state, "invalid fragment size: %s", arg);
+         break;
+      case OPT_TRANSPORT:
+         if (strcmp(arg, "websocket") && strcmp(arg, "tcp"))
+            argp_error(state, "invalid transport: %s", arg);
+         arguments->transport = arg;
+         break;
+      case OPT_NAGLE:
+         arguments->nagle = true;
+         break;
+      case OPT_SEND_BUFFER:
+         arguments->send_buffer = atoi(arg);
+         if (arguments->send_buffer <= 0)
+            argp_error(state, "invalid send buffer size: %s", arg);
+         break;
+      case OPT_RECEIVE_BUFFER:
+         arguments->receive_buffer = atoi(arg);
+         if (arguments->receive_buffer <= 0)
+            argp_error(state, "invalid receive buffer size: %s", arg);
+         break;
+      case OPT_KEEP_ALIVE:
+         arguments->keep_alive = atoi(arg);
+         if (arguments->keep_alive < 0)
+            argp_error(state, "invalid keepalive time: %s", arg);
+         break;
+      case OPT_RECONNECT_MIN:
+         arguments->reconnect_min = atoi(arg);
+         if (arguments->reconnect_min <= 0)
+            argp_error(state, "invalid reconnect delay: %s", arg);
+         break;
+      case OPT_RECONNECT_MAX:
+         arguments->reconnect_max = atoi(arg);
+         if (arguments->reconnect_max <= 0)
+            argp_error(state, "invalid reconnect delay: %s", arg);
+         break;
+      case OPT_IO_CPU:
+         arguments->io_cpu = atoi(arg);
+         if (arguments->io_cpu < 0)
+            argp_error(state, "invalid cpu: %s", arg);
+         break;
+      case OPT_SERVICE_LIMIT:
+         arguments->service_limit = atoi(arg);
+         if (arguments->service_limit < 0)
+            argp_error(state, "invalid service call limit: %s", arg);
+         break;
+      case OPT_METRICS_PORT:
+         arguments->metrics_port = atoi(arg);
+         if (arguments->metrics_port < 0 || arguments->metrics_port > 65535)
+            argp_error(state, "invalid metrics port: %s", arg);
+         break;
+      case OPT_METRICS_ADDRESS:
+         arguments->metrics_address = arg;
+         break;
+      case OPT_STATUS_INTERVAL:
+         arguments->status_interval = atoi(arg);
+         if (arguments->status_interval < 0)
+            argp_error(state, "invalid status interval: %s", arg);
+         break;
+      case OPT_CAPTURE:
+         arguments->capture = arg;
+         break;
+      case OPT_REPLAY:
+         arguments->replay = arg;
+         break;
+      case OPT_REPLAY_SPEED:
+         arguments->replay_speed = atof(arg);
+         if (arguments->replay_speed < 0)
+            argp_error(state, "invalid replay speed: %s", arg);
+         break;
+      case OPT_QUEUE_DEPTH:
+         arguments->queue_depth = atoi(arg);
+         if (arguments->queue_depth <= 0)
+            argp_error(state, "invalid queue depth: %s", arg);
+         break;
+      case OPT_QUEUE_POLICY:
+         if (strcmp(arg, "oldest") && strcmp(arg, "newest") && strcmp(arg, "block"))
+            argp_error(state, "invalid queue policy: %s", arg);
+         arguments->queue_policy = arg;
+         break;
       case ARGP_KEY_ARG: 
          argp_usage (state);
          break;
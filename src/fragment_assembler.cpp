@@ -0,0 +1,195 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "rapidjson/reader.h"
+
+#include "amm/BaseLogger.h"
+#include "cbor.hpp"
+#include "fragment_assembler.hpp"
+
+namespace {
+
+// SAX handler reading the top level fields of a fragment op. Strings point
+// into the message, which a json parse unescapes in place.
+struct fragment_fields {
+   enum field_key { none, id_key, data_key, num_key, total_key };
+
+   const char* id = nullptr;
+   std::size_t id_length = 0;
+   char id_number[24];          // numeric ids as text
+   const char* data = nullptr;
+   std::size_t data_length = 0;
+   int64_t num = -1;
+   int64_t total = -1;
+
+   int depth = 0;
+   field_key key = none;
+
+   bool number(int64_t n)
+   {
+      if (key == num_key) num = n;
+      else if (key == total_key) total = n;
+      else if (key == id_key) {
+         id_length = (std::size_t)snprintf(id_number, sizeof(id_number), "%lld", (long long)n);
+         id = id_number;
+      }
+      key = none;
+      return true;
+   }
+   bool value() { key = none; return true; }
+
+   bool Null() { return value(); }
+   bool Bool(bool) { return value(); }
+   bool Int(int i) { return number(i); }
+   bool Uint(unsigned u) { return number(u); }
+   bool Int64(int64_t i) { return number(i); }
+   bool Uint64(uint64_t u) { return number((int64_t)u); }
+   bool Double(double) { return value(); }
+   bool RawNumber(const char*, rapidjson::SizeType, bool) { return value(); }
+
+   bool String(const char* str, rapidjson::SizeType length, bool)
+   {
+      if (key == id_key) { id = str; id_length = length; }
+      else if (key == data_key) { data = str; data_length = length; }
+      key = none;
+      return true;
+   }
+
+   bool Key(const char* str, rapidjson::SizeType length, bool)
+   {
+      key = none;
+      if (depth != 1) return true;
+      if (length == 2 && std::memcmp(str, "id", 2) == 0) key = id_key;
+      else if (length == 4 && std::memcmp(str, "data", 4) == 0) key = data_key;
+      else if (length == 3 && std::memcmp(str, "num", 3) == 0) key = num_key;
+      else if (length == 5 && std::memcmp(str, "total", 5) == 0) key = total_key;
+      return true;
+   }
+
+   bool StartObject() { key = none; ++depth; return true; }
+   bool EndObject(rapidjson::SizeType) { --depth; return true; }
+   bool StartArray() { key = none; ++depth; return true; }
+   bool EndArray(rapidjson::SizeType) { --depth; return true; }
+};
+
+}
+
+fragment_assembler::fragment_assembler(handler h, const fragment_limits& limits)
+   : handler_(std::move(h))
+   , limits_(limits)
+   , sets_(std::max<std::size_t>(limits.sets, 1))
+{
+   for (set& s : sets_)
+      s.buffer.reserve(limits_.reserve);
+}
+
+bool fragment_assembler::add(char* data, std::size_t size, bool binary)
+{
+   fragment_fields f;
+   if (binary) {
+      if (!cbor_parse(data, size, f)) return false;
+   } else {
+      rapidjson::Reader reader;
+      rapidjson::InsituStringStream stream(data);
+      if (reader.Parse<rapidjson::kParseInsituFlag>(stream, f).IsError()) return false;
+   }
+   if (!f.id || !f.data || f.num < 0 || f.total <= 0 || f.num >= f.total) return false;
+
+   clock::time_point now = clock::now();
+   expire(now);
+
+   set* s = find(f.id, f.id_length);
+   if ((uint64_t)f.total > limits_.fragments) {
+      if (s) drop(*s, "too many fragments");
+      else if (f.num == 0) {
+         ++dropped_;
+         LOG_WARNING << "Dropped fragmented ROS message, " << f.total << " fragments";
+      }
+      return true;
+   }
+   if (f.num == 0) {
+      if (s) drop(*s, "restarted");
+      s = &start(f.id, f.id_length, now);
+      s->total = f.total;
+      // nothing is reserved from the announced size: the buffer grows with
+      // the data that arrived, which is what counts against the memory limit
+   } else if (!s) {
+      // the rest of a dropped set
+      return true;
+   }
+
+   if (f.num != s->next || f.total != s->total) {
+      drop(*s, "fragment missing");
+      return true;
+   }
+   if (buffered_ + f.data_length > limits_.memory) {
+      drop(*s, "memory limit");
+      return true;
+   }
+
+   s->buffer.append(f.data, f.data_length);
+   buffered_ += f.data_length;
+   if (++s->next < s->total) return true;
+
+   ++completed_;
+   handler_(&s->buffer[0], s->buffer.size());
+   release(*s);
+   return true;
+}
+
+fragment_assembler::set* fragment_assembler::find(const char* id, std::size_t length)
+{
+   for (set& s : sets_)
+      if (s.active && s.id.size() == length && std::memcmp(s.id.data(), id, length) == 0) return &s;
+   return nullptr;
+}
+
+fragment_assembler::set& fragment_assembler::start(const char* id, std::size_t length, clock::time_point now)
+{
+   set* free = nullptr;
+   set* oldest = nullptr;
+   for (set& s : sets_) {
+      if (!s.active) { free = &s; break; }
+      if (!oldest || s.started < oldest->started) oldest = &s;
+   }
+   if (!free) {
+      drop(*oldest, "replaced by a newer message");
+      free = oldest;
+   }
+   free->id.assign(id, length);
+   free->next = 0;
+   free->total = 0;
+   free->started = now;
+   free->active = true;
+   return *free;
+}
+
+void fragment_assembler::expire(clock::time_point now)
+{
+   for (set& s : sets_)
+      if (s.active && now - s.started > limits_.timeout) drop(s, "timed out");
+}
+
+void fragment_assembler::drop(set& s, const char* reason)
+{
+   ++dropped_;
+   LOG_WARNING << "Dropped fragmented ROS message " << s.id << ", " << reason << " after "
+               << s.next << " of " << s.total << " fragments";
+   release(s);
+}
+
+void fragment_assembler::release(set& s)
+{
+   buffered_ -= s.buffer.size();
+   s.buffer.clear();
+   // give back what an unusually large message took
+   if (s.buffer.capacity() > 4 * limits_.reserve) {
+      std::string().swap(s.buffer);
+      s.buffer.reserve(limits_.reserve);
+   }
+   s.active = false;
+}
@@ -0,0 +1,81 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Limits of a fragment_assembler
+ */
+struct fragment_limits {
+   std::size_t sets = 4;                        // messages assembled at the same time
+   std::size_t fragments = 65536;               // fragments per message
+   std::size_t memory = 16 * 1024 * 1024;       // bytes buffered by all sets
+   std::size_t reserve = 64 * 1024;             // buffer preallocated per set
+   std::chrono::milliseconds timeout{10000};    // from the first to the last fragment
+};
+
+/**
+ * @brief Fragment_Assembler joins the rosbridge fragment ops of a message
+ * that was sent in parts, {"op":"fragment","id":..,"data":..,"num":..,"total":..}.
+ *
+ * Messages are assembled in a fixed number of sets whose buffers are
+ * allocated up front and reused. The data of each fragment is appended in
+ * place, and the message is handed on once its last fragment arrived, to be
+ * parsed once as a whole. Fragments have to arrive in order, as rosbridge
+ * sends them. A set is dropped when a fragment is missing, when it would
+ * take the bytes buffered by all sets over the memory limit, or when it is
+ * not complete within the timeout; a message announced in more fragments
+ * than the limit is not assembled. Timeouts are checked as fragments
+ * arrive. When all sets are in use, a new message replaces the oldest.
+ *
+ * Not thread safe: one assembler per connection, used by its read handler.
+ */
+class fragment_assembler
+{
+public:
+   // the complete message text, writable and null terminated. Only valid
+   // during the call.
+   typedef std::function<void(char* data, std::size_t size)> handler;
+
+   fragment_assembler(handler h, const fragment_limits& limits);
+
+   // a fragment op, json text (parsed in place) or cbor. Returns false if
+   // it is malformed.
+   bool add(char* data, std::size_t size, bool binary);
+
+   std::size_t completed() const { return completed_; }
+   std::size_t dropped() const { return dropped_; }
+   std::size_t buffered() const { return buffered_; }
+
+private:
+   typedef std::chrono::steady_clock clock;
+
+   struct set {
+      std::string id;
+      std::string buffer;
+      int64_t next = 0;
+      int64_t total = 0;
+      clock::time_point started;
+      bool active = false;
+   };
+
+   handler handler_;
+   fragment_limits limits_;
+   std::vector<set> sets_;
+   std::size_t buffered_ = 0;
+   std::size_t completed_ = 0;
+   std::size_t dropped_ = 0;
+
+   set* find(const char* id, std::size_t length);
+   set& start(const char* id, std::size_t length, clock::time_point now);
+   void expire(clock::time_point now);
+   void drop(set& s, const char* reason);
+   void release(set& s);
+};
@@ -0,0 +1,61 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#include "ingest_pipeline.hpp"
+
+namespace net = boost::asio;
+
+ingest_pipeline::ingest_pipeline(net::io_context& ioc, handler h)
+   : strand_(net::make_strand(ioc))
+   , handler_(std::move(h))
+{
+}
+
+std::size_t ingest_pipeline::add_source(std::size_t capacity)
+{
+   sources_.emplace_back(new spsc_ring<ingest_event>(capacity));
+   return sources_.size() - 1;
+}
+
+bool ingest_pipeline::push(std::size_t source, const ingest_event& event)
+{
+   if (!sources_[source]->push(event)) {
+      dropped_++;
+      return false;
+   }
+   schedule();
+   return true;
+}
+
+// start a drain unless one is already scheduled
+void ingest_pipeline::schedule()
+{
+   if (!drain_scheduled_.exchange(true))
+      net::post(strand_, [this]() { drain(); });
+}
+
+void ingest_pipeline::drain()
+{
+   // clear the flag first: events pushed from here on schedule a new drain
+   // if this one misses them.
+   drain_scheduled_ = false;
+
+   // take events from all sources in turn so a busy source can not starve
+   // the others
+   std::size_t count = 0;
+   bool more = true;
+   ingest_event event;
+   while (more && count < drain_budget) {
+      more = false;
+      for (auto& source : sources_) {
+         if (!source->pop(event)) continue;
+         handler_(event);
+         ++count;
+         more = true;
+      }
+   }
+   drained_ += count;
+
+   // over budget: let queued writes run, then continue
+   if (more) schedule();
+}
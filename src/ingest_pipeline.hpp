@@ -0,0 +1,72 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "spsc_ring.hpp"
+
+/**
+ * @brief Compact event handed from a DDS listener thread to the I/O thread
+ */
+struct ingest_event {
+   enum kind : std::uint8_t {
+      phys_value,        // id: signal_registry id
+      waveform_sample,   // id: waveform index
+      tick,              // frame: tick frame
+      sim_control,       // id: AMM::ControlType
+   };
+   kind type;
+   std::int32_t id;
+   double value;
+   std::int64_t timestamp;   // steady clock ns at reception
+   std::int64_t source;      // steady clock ns when published, 0 if unknown
+   std::int64_t frame;
+};
+
+/**
+ * @brief Ingest_Pipeline Class moves events from DDS listener threads to
+ * the I/O thread.
+ *
+ * Every source (DDS topic) has its own SPSC ring, written only by the
+ * listener thread of that topic. Pushing never blocks and never allocates;
+ * events are dropped and counted when a ring is full. The first push into
+ * an idle pipeline posts a drain to the I/O strand, which hands all queued
+ * events to the handler on the I/O thread.
+ */
+class ingest_pipeline
+{
+public:
+   typedef std::function<void(const ingest_event&)> handler;
+
+   ingest_pipeline(boost::asio::io_context& ioc, handler h);
+
+   // add a source ring, before events are pushed. Returns the source index.
+   std::size_t add_source(std::size_t capacity);
+
+   // push from the listener thread of the source
+   bool push(std::size_t source, const ingest_event& event);
+
+   std::size_t dropped() const { return dropped_; }
+   std::size_t drained() const { return drained_; }
+
+private:
+   static const std::size_t drain_budget = 1024;   // events per drain before yielding to writes
+
+   boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+   handler handler_;
+   std::vector<std::unique_ptr<spsc_ring<ingest_event>>> sources_;
+   std::atomic<bool> drain_scheduled_{false};
+   std::atomic<std::size_t> dropped_{0};
+   std::size_t drained_ = 0;
+
+   void schedule();
+   void drain();
+};
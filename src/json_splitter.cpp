@@ -0,0 +1,96 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#include <algorithm>
+#include <cstring>
+
+#include "json_splitter.hpp"
+
+json_splitter::json_splitter(std::size_t max_message, std::size_t reserve)
+   : max_message_(max_message)
+   , reserve_(reserve)
+{
+   buffer_.resize(reserve_);
+}
+
+boost::asio::mutable_buffer json_splitter::prepare(std::size_t min)
+{
+   // move the incomplete message to the front
+   if (begin_ > 0) {
+      std::memmove(&buffer_[0], &buffer_[begin_], end_ - begin_);
+      scanned_ -= begin_;
+      end_ -= begin_;
+      begin_ = 0;
+   }
+   // one byte more for the terminator of a message ending at end_
+   std::size_t needed = end_ + min + 1;
+   if (buffer_.size() < needed)
+      buffer_.resize(std::max(needed, 2 * buffer_.size()));
+   return boost::asio::buffer(&buffer_[end_], buffer_.size() - end_ - 1);
+}
+
+bool json_splitter::commit(std::size_t size, const handler& h)
+{
+   end_ += size;
+   for (; scanned_ < end_; ++scanned_) {
+      char c = buffer_[scanned_];
+      if (in_string_) {
+         if (escaped_) escaped_ = false;
+         else if (c == '\\') escaped_ = true;
+         else if (c == '"') in_string_ = false;
+         continue;
+      }
+      if (depth_ == 0) {
+         if (c == ' ' || c == '\n' || c == '\r' || c == '\t') continue;
+         if (c != '{') {
+            reset();
+            return false;
+         }
+         begin_ = scanned_;
+      }
+      switch (c) {
+         case '"' :
+            in_string_ = true;
+            break;
+         case '{' :
+         case '[' :
+            ++depth_;
+            break;
+         case '}' :
+         case ']' :
+            if (--depth_ > 0) break;
+            {
+               // terminate in place, the byte behind belongs to the next message
+               std::size_t end = scanned_ + 1;
+               char next = buffer_[end];
+               buffer_[end] = '\0';
+               h(&buffer_[begin_], end - begin_);
+               buffer_[end] = next;
+               begin_ = end;
+            }
+            break;
+      }
+   }
+
+   if (depth_ == 0) {
+      // nothing incomplete; start over at the front, and give back what
+      // an unusually large message took
+      begin_ = scanned_ = end_ = 0;
+      if (buffer_.size() > 4 * reserve_) {
+         std::string().swap(buffer_);
+         buffer_.resize(reserve_);
+      }
+   } else if (end_ - begin_ > max_message_) {
+      reset();
+      return false;
+   }
+   return true;
+}
+
+void json_splitter::reset()
+{
+   begin_ = scanned_ = end_ = 0;
+   depth_ = 0;
+   in_string_ = false;
+   escaped_ = false;
+}
@@ -0,0 +1,55 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+#include <boost/asio/buffer.hpp>
+
+/**
+ * @brief Json_Splitter cuts a stream of json objects sent back to back, as
+ * rosbridge sends them over plain TCP, into messages.
+ *
+ * Bytes are read into the splitter's buffer and scanned once, by brace
+ * counting that skips strings; the scan state is kept between reads, so a
+ * message split across reads is not scanned again. Every complete top
+ * level object is handed on where it lies in the buffer, writable and null
+ * terminated so it can be parsed in place. Whitespace between objects is
+ * skipped, anything else is an error.
+ *
+ * A message may be up to max_message bytes. The buffer grows to the size of
+ * the largest message, and shrinks back once it is empty.
+ */
+class json_splitter
+{
+public:
+   // a complete message, only valid during the call
+   typedef std::function<void(char* data, std::size_t size)> handler;
+
+   explicit json_splitter(std::size_t max_message = 64 * 1024 * 1024, std::size_t reserve = 64 * 1024);
+
+   // free space behind the data read so far, at least min bytes
+   boost::asio::mutable_buffer prepare(std::size_t min = 16 * 1024);
+   // size bytes were read into the prepared space. Hands on the messages
+   // they complete. Returns false if the stream is not json objects or a
+   // message is too large; the splitter is reset then.
+   bool commit(std::size_t size, const handler& h);
+   void reset();
+
+   // bytes of the incomplete message
+   std::size_t buffered() const { return end_ - begin_; }
+
+private:
+   std::string buffer_;
+   std::size_t max_message_;
+   std::size_t reserve_;
+   std::size_t begin_ = 0;     // start of the incomplete message
+   std::size_t scanned_ = 0;   // scanned up to here
+   std::size_t end_ = 0;       // read up to here
+   int depth_ = 0;
+   bool in_string_ = false;
+   bool escaped_ = false;
+};
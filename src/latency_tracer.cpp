@@ -0,0 +1,157 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+
+#include "amm/BaseLogger.h"
+#include "latency_tracer.hpp"
+
+latency_histogram::latency_histogram()
+   : counts_(new std::atomic<uint64_t>[buckets])
+{
+   reset();
+}
+
+int latency_histogram::bucket(int64_t ns)
+{
+   if (ns < 0) ns = 0;
+   if (ns < (1 << sub_bits)) return (int)ns;
+   int msb = 63 - __builtin_clzll((unsigned long long)ns);
+   int shift = msb - sub_bits;
+   int b = (shift + 1) * (1 << sub_bits) + (int)((ns >> shift) & ((1 << sub_bits) - 1));
+   return b < buckets ? b : buckets - 1;
+}
+
+int64_t latency_histogram::lower_bound(int b)
+{
+   if (b < (1 << sub_bits)) return b;
+   int group = b >> sub_bits;
+   int64_t sub = b & ((1 << sub_bits) - 1);
+   return ((1 << sub_bits) + sub) << (group - 1);
+}
+
+void latency_histogram::record(int64_t ns)
+{
+   counts_[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+   count_.fetch_add(1, std::memory_order_relaxed);
+   if (ns > max_.load(std::memory_order_relaxed))
+      max_.store(ns, std::memory_order_relaxed);
+}
+
+int64_t latency_histogram::percentile(double p) const
+{
+   uint64_t total = count();
+   if (total == 0) return 0;
+   uint64_t rank = (uint64_t)(p / 100.0 * (double)total);
+   if (rank >= total) rank = total - 1;
+   uint64_t seen = 0;
+   for (int b = 0; b < buckets; ++b) {
+      seen += counts_[b].load(std::memory_order_relaxed);
+      if (seen > rank) return lower_bound(b);
+   }
+   return max();
+}
+
+void latency_histogram::reset()
+{
+   for (int b = 0; b < buckets; ++b)
+      counts_[b].store(0, std::memory_order_relaxed);
+   count_.store(0, std::memory_order_relaxed);
+   max_.store(0, std::memory_order_relaxed);
+}
+
+const char* latency_tracer::stage_name(stage s)
+{
+   switch (s) {
+      case source_to_receive : return "source->receive";
+      case receive_to_enqueue : return "receive->enqueue";
+      case enqueue_to_write : return "enqueue->write";
+      case write_to_done : return "write->done";
+      case end_to_end : return "receive->done";
+      default : return "";
+   }
+}
+
+latency_tracer::latency_tracer(std::size_t recorder_size)
+   : recorder_(recorder_size)
+{
+}
+
+int latency_tracer::topic(const std::string& name)
+{
+   for (std::size_t i = 0; i < topics_.size(); ++i)
+      if (topics_[i] == name) return (int)i;
+   topics_.push_back(name);
+   histograms_.emplace_back(new latency_histogram[stages]);
+   return (int)topics_.size() - 1;
+}
+
+int64_t latency_tracer::now()
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void latency_tracer::record(const message_trace& trace, int64_t write_start, int64_t write_done, std::size_t bytes)
+{
+   if (trace.topic < 0 || trace.topic >= (int)topics_.size()) return;
+   latency_histogram* h = histograms_[trace.topic].get();
+   if (trace.source && trace.received)
+      h[source_to_receive].record(trace.received - trace.source);
+   if (trace.received)
+      h[receive_to_enqueue].record(trace.enqueued - trace.received);
+   h[enqueue_to_write].record(write_start - trace.enqueued);
+   h[write_to_done].record(write_done - write_start);
+   if (trace.received)
+      h[end_to_end].record(write_done - trace.received);
+
+   std::size_t n = recorded_.load(std::memory_order_relaxed);
+   recorder_[n % recorder_.size()] = {trace.topic, trace.source, trace.received, trace.enqueued, write_start, write_done, bytes};
+   recorded_.store(n + 1, std::memory_order_release);
+}
+
+const latency_histogram& latency_tracer::histogram(int topic, stage s) const
+{
+   return histograms_[topic][s];
+}
+
+void latency_tracer::log_summary() const
+{
+   auto us = [](int64_t ns) { return ns / 1000.0; };
+   for (std::size_t t = 0; t < topics_.size(); ++t) {
+      for (int s = 0; s < stages; ++s) {
+         const latency_histogram& h = histograms_[t][s];
+         if (h.count() == 0) continue;
+         std::ostringstream line;
+         line << std::fixed << std::setprecision(1)
+              << "latency " << topics_[t] << " " << stage_name((stage)s)
+              << " n=" << h.count()
+              << " p50=" << us(h.percentile(50)) << "us"
+              << " p90=" << us(h.percentile(90)) << "us"
+              << " p99=" << us(h.percentile(99)) << "us"
+              << " p99.9=" << us(h.percentile(99.9)) << "us"
+              << " max=" << us(h.max()) << "us";
+         LOG_INFO << line.str();
+      }
+   }
+}
+
+void latency_tracer::dump_recorder() const
+{
+   std::size_t n = recorded_.load(std::memory_order_acquire);
+   std::size_t size = recorder_.size();
+   std::size_t first = n > size ? n - size : 0;
+   LOG_INFO << "flight recorder: last " << (n - first) << " of " << n << " messages (ns relative to receive)";
+   for (std::size_t i = first; i < n; ++i) {
+      const record_entry& r = recorder_[i % size];
+      int64_t base = r.received ? r.received : r.enqueued;
+      LOG_INFO << topics_[r.topic]
+               << " source=" << (r.source ? r.source - base : 0)
+               << " enqueue=" << r.enqueued - base
+               << " write=" << r.write_start - base
+               << " done=" << r.write_done - base
+               << " bytes=" << r.bytes;
+   }
+}
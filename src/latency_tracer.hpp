@@ -0,0 +1,102 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Timestamps of a message on its way from DDS to ROS, steady clock ns
+ */
+struct message_trace {
+   int topic = -1;           // latency_tracer topic id, -1: not traced
+   int64_t source = 0;       // published by the AMM module, 0 if unknown
+   int64_t received = 0;     // DDS callback entry
+   int64_t enqueued = 0;     // serialized and queued for the endpoints
+};
+
+/**
+ * @brief Latency_Histogram counts latencies in log-linear buckets, HDR style.
+ *
+ * Values below 16 ns have their own bucket, above that every power of two
+ * is split in 16 buckets, so percentiles are within ~6% of the true value
+ * up to about 18 minutes. Single writer; readers may run on other threads.
+ */
+class latency_histogram
+{
+public:
+   static const int sub_bits = 4;
+   static const int buckets = (41 - sub_bits) * (1 << sub_bits);
+
+   latency_histogram();
+
+   void record(int64_t ns);
+   uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+   int64_t max() const { return max_.load(std::memory_order_relaxed); }
+   // value at percentile p (0..100), lower bound of its bucket
+   int64_t percentile(double p) const;
+   void reset();
+
+   static int bucket(int64_t ns);
+   static int64_t lower_bound(int b);
+
+private:
+   std::unique_ptr<std::atomic<uint64_t>[]> counts_;
+   std::atomic<uint64_t> count_{0};
+   std::atomic<int64_t> max_{0};
+};
+
+/**
+ * @brief Latency_Tracer aggregates message traces per stage and topic and
+ * keeps the last records in a flight recorder ring.
+ *
+ * Topics are registered at setup. record() is called by the websocket
+ * sessions when a write completes; all sessions run on the I/O thread, so
+ * the tracer has a single writer.
+ */
+class latency_tracer
+{
+public:
+   enum stage {
+      source_to_receive,   // AMM publisher to DDS callback
+      receive_to_enqueue,  // DDS callback to serialized (includes publish scheduling)
+      enqueue_to_write,    // waiting in the outbound queue
+      write_to_done,       // websocket write
+      end_to_end,          // DDS callback to written
+      stages
+   };
+   static const char* stage_name(stage s);
+
+   struct record_entry {
+      int topic;
+      int64_t source, received, enqueued, write_start, write_done;
+      std::size_t bytes;
+   };
+
+   explicit latency_tracer(std::size_t recorder_size = 1024);
+
+   // setup time only
+   int topic(const std::string& name);
+   const std::string& topic_name(int id) const { return topics_[id]; }
+   std::size_t topics() const { return topics_.size(); }
+
+   void record(const message_trace& trace, int64_t write_start, int64_t write_done, std::size_t bytes);
+   const latency_histogram& histogram(int topic, stage s) const;
+
+   // log percentiles of every stage and topic
+   void log_summary() const;
+   // log the flight recorder, oldest record first
+   void dump_recorder() const;
+
+   static int64_t now();
+
+private:
+   std::vector<std::string> topics_;
+   std::vector<std::unique_ptr<latency_histogram[]>> histograms_;   // [topic][stage]
+   std::vector<record_entry> recorder_;
+   std::atomic<std::size_t> recorded_{0};
+};
@@ -0,0 +1,104 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#include <cstddef>
+#include <new>
+#include <thread>
+
+#include "bounded_queue.hpp"
+#include "message_pool.hpp"
+
+namespace {
+
+// a pooled message and room for the control block of the shared_ptr it is
+// handed out with
+struct slot {
+   outbound_message message;
+   alignas(std::max_align_t) unsigned char control[128];
+};
+
+}
+
+struct message_pool::state {
+   std::unique_ptr<slot[]> slots;
+   bounded_queue<std::size_t> free;
+
+   // twice the slots, so a push does not lap a pop still in progress
+   explicit state(std::size_t count) : slots(new slot[count]), free(2 * count) {}
+
+   void release(std::size_t index)
+   {
+      // there is always room; a push only fails while a pop of the same
+      // cell is finishing
+      while (!free.try_push(std::size_t(index)))
+         std::this_thread::yield();
+   }
+};
+
+// places the control block of a handed out message in its slot. The
+// control block is given back last, after the message was released and
+// the deleter destroyed, which makes that the time to free the slot.
+template <typename T>
+struct message_pool::slot_allocator {
+   typedef T value_type;
+
+   std::shared_ptr<state> pool;
+   std::size_t index;
+
+   slot_allocator(std::shared_ptr<state> p, std::size_t i) : pool(std::move(p)), index(i) {}
+   template <typename U>
+   slot_allocator(const slot_allocator<U>& other) : pool(other.pool), index(other.index) {}
+
+   T* allocate(std::size_t n)
+   {
+      static_assert(sizeof(T) <= sizeof(slot::control), "control block does not fit the slot");
+      static_assert(alignof(T) <= alignof(std::max_align_t), "control block alignment");
+      if (n != 1) throw std::bad_alloc();
+      return reinterpret_cast<T*>(pool->slots[index].control);
+   }
+
+   void deallocate(T*, std::size_t)
+   {
+      pool->release(index);
+   }
+
+   template <typename U>
+   bool operator==(const slot_allocator<U>& other) const { return pool == other.pool && index == other.index; }
+   template <typename U>
+   bool operator!=(const slot_allocator<U>& other) const { return !(*this == other); }
+};
+
+void message_pool::reserve(std::size_t count, std::size_t capacity)
+{
+   state_ = std::make_shared<state>(count);
+   for (std::size_t i = 0; i < count; ++i) {
+      state_->slots[i].message.data.reserve(capacity);
+      state_->release(i);
+   }
+   count_ = count;
+   capacity_ = capacity;
+}
+
+std::shared_ptr<outbound_message> message_pool::acquire()
+{
+   std::size_t index;
+   if (state_ && state_->free.try_pop(index)) {
+      // the last session let go of the message before its slot was pushed
+      // with a release store, which the pop read with acquire
+      outbound_message* message = &state_->slots[index].message;
+      if (message->data.capacity() > max_retained) {
+         std::string().swap(message->data);
+         message->data.reserve(capacity_);
+      }
+      message->data.clear();
+      message->trace = message_trace();
+      hits_.fetch_add(1, std::memory_order_relaxed);
+      // the slot owns the message, releasing it frees the slot
+      return std::shared_ptr<outbound_message>(message, [](outbound_message*) {},
+                                               slot_allocator<outbound_message>(state_, index));
+   }
+   misses_.fetch_add(1, std::memory_order_relaxed);
+   auto message = std::make_shared<outbound_message>();
+   message->data.reserve(capacity_);
+   return message;
+}
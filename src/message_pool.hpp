@@ -0,0 +1,52 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+#include "ros_session.hpp"
+
+/**
+ * @brief Message_Pool recycles outbound messages, so serializing a message
+ * and queueing it with every session does not allocate.
+ *
+ * Free messages are kept on a lock-free free list, so acquire() takes one
+ * in constant time however many are still queued. A message goes back on
+ * the list when its last reference is released, i.e. every session that
+ * queued it has written or dropped it: the shared_ptr handed out puts its
+ * control block into storage of the slot, and giving that storage back
+ * returns the slot. Nothing is allocated per message. Its string keeps the
+ * capacity it grew to, up to max_retained. When all messages are in use
+ * acquire() returns a new one from the heap and counts a miss.
+ *
+ * acquire() may be called from any thread. Messages may outlive the pool.
+ */
+class message_pool
+{
+public:
+   static const std::size_t max_retained = 64 * 1024;
+
+   // setup time only, before the first acquire()
+   void reserve(std::size_t count, std::size_t capacity);
+   std::size_t size() const { return count_; }
+
+   // empty message to render into and write
+   std::shared_ptr<outbound_message> acquire();
+
+   std::size_t hits() const { return hits_; }
+   std::size_t misses() const { return misses_; }
+
+private:
+   struct state;
+   template <typename T> struct slot_allocator;
+
+   // slots and free list, shared with the messages handed out
+   std::shared_ptr<state> state_;
+   std::size_t count_ = 0;
+   std::size_t capacity_ = 0;
+   std::atomic<std::size_t> hits_{0};
+   std::atomic<std::size_t> misses_{0};
+};
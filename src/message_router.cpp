@@ -0,0 +1,130 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#include <cstring>
+
+#include "rapidjson/reader.h"
+
+#include "cbor.hpp"
+#include "message_router.hpp"
+
+bool message_peek::field::is(const char* value) const
+{
+   return present && std::strlen(value) == length && std::memcmp(data(), value, length) == 0;
+}
+
+bool message_peek::value()
+{
+   key_ = nullptr;
+   return true;
+}
+
+bool message_peek::String(const char* str, rapidjson::SizeType length, bool copy)
+{
+   if (key_) {
+      if (length < sizeof(key_->text)) {
+         std::memcpy(key_->text, str, length);
+         key_->text[length] = '\0';
+      } else {
+         key_->overflow.assign(str, length);
+      }
+      key_->length = length;
+      key_->present = true;
+   }
+   key_ = nullptr;
+   return !complete();
+}
+
+bool message_peek::Key(const char* str, rapidjson::SizeType length, bool copy)
+{
+   key_ = nullptr;
+   if (depth_ != 1) return true;
+   if (length == 2 && std::memcmp(str, "op", 2) == 0) key_ = &op;
+   else if (length == 5 && std::memcmp(str, "topic", 5) == 0) key_ = &topic;
+   else if (length == 2 && std::memcmp(str, "id", 2) == 0) key_ = &id;
+   else if (length == 4 && std::memcmp(str, "type", 4) == 0) key_ = &type;
+   return true;
+}
+
+bool message_peek::StartObject()
+{
+   key_ = nullptr;
+   ++depth_;
+   return true;
+}
+
+bool message_peek::EndObject(rapidjson::SizeType)
+{
+   --depth_;
+   return true;
+}
+
+bool message_peek::StartArray()
+{
+   key_ = nullptr;
+   ++depth_;
+   return true;
+}
+
+bool message_peek::EndArray(rapidjson::SizeType)
+{
+   --depth_;
+   return true;
+}
+
+bool message_peek::complete()
+{
+   // a publish is routed by topic, a service_response by id, everything
+   // else by op alone. "type":"ros_topic" marks messages of the legacy format.
+   if (type.is("ros_topic")) return stopped = true;
+   if (!op.present) return false;
+   if (op.is("publish")) return topic.present && (stopped = true);
+   if (op.is("service_response")) return id.present && (stopped = true);
+   return stopped = true;
+}
+
+bool message_peek::peek(const char* data, std::size_t size, bool binary)
+{
+   if (binary) {
+      bool ok = cbor_parse(data, size, *this);
+      return ok || stopped;
+   }
+   rapidjson::Reader reader;
+   rapidjson::StringStream stream(data);
+   reader.Parse(stream, *this);
+   return stopped || !reader.HasParseError();
+}
+
+void message_router::add(const std::string& topic, handler h)
+{
+   routes_.emplace_back(topic, std::move(h));
+}
+
+int message_router::route(const message_peek::field& topic) const
+{
+   if (!topic.present) return -1;
+   for (std::size_t i = 0; i < routes_.size(); ++i) {
+      const std::string& t = routes_[i].first;
+      if (t.size() == topic.length && std::memcmp(t.data(), topic.data(), topic.length) == 0)
+         return (int)i;
+   }
+   return -1;
+}
+
+bool message_router::routed(const message_peek::field& topic) const
+{
+   return route(topic) >= 0;
+}
+
+bool message_router::dispatch(const message_peek::field& topic, const rapidjson::Value& msg) const
+{
+   int i = route(topic);
+   if (i < 0) return false;
+   routes_[i].second(msg);
+   return true;
+}
+
+std::size_t message_router::size() const
+{
+   return routes_.size();
+}
@@ -0,0 +1,88 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "rapidjson/document.h"
+
+/**
+ * @brief Message_Peek is a SAX handler reading only the envelope of a
+ * rosbridge message: the top level "op", "topic", "id" and "type" strings.
+ *
+ * It stops the parse as soon as it has seen enough to route the message,
+ * which for rosbridge messages is usually within the first few dozen bytes.
+ * Strings are copied into fixed buffers, so peeking does not allocate; a
+ * longer string is copied to the heap, it is still routed.
+ */
+struct message_peek
+{
+   struct field {
+      char text[128];
+      std::string overflow;   // a string too long for text
+      std::size_t length = 0;
+      bool present = false;
+      const char* data() const { return length < sizeof(text) ? text : overflow.c_str(); }
+      bool is(const char* value) const;
+   };
+
+   field op;
+   field topic;
+   field id;
+   field type;
+   bool stopped = false;   // parse was stopped on purpose
+
+   bool Null() { return value(); }
+   bool Bool(bool) { return value(); }
+   bool Int(int) { return value(); }
+   bool Uint(unsigned) { return value(); }
+   bool Int64(int64_t) { return value(); }
+   bool Uint64(uint64_t) { return value(); }
+   bool Double(double) { return value(); }
+   bool RawNumber(const char*, rapidjson::SizeType, bool) { return value(); }
+   bool String(const char* str, rapidjson::SizeType length, bool copy);
+   bool Key(const char* str, rapidjson::SizeType length, bool copy);
+   bool StartObject();
+   bool EndObject(rapidjson::SizeType);
+   bool StartArray();
+   bool EndArray(rapidjson::SizeType);
+
+   // peek a json text message or a cbor binary message. Returns false if
+   // the message is malformed before its envelope was read.
+   bool peek(const char* data, std::size_t size, bool binary);
+
+private:
+   int depth_ = 0;
+   field* key_ = nullptr;   // top level field the next value belongs to
+
+   bool value();
+   bool complete();
+};
+
+/**
+ * @brief Message_Router dispatches rosbridge publish messages to the
+ * handler registered for their topic.
+ */
+class message_router
+{
+public:
+   typedef std::function<void(const rapidjson::Value& msg)> handler;
+
+   void add(const std::string& topic, handler h);
+   bool routed(const message_peek::field& topic) const;
+   bool dispatch(const message_peek::field& topic, const rapidjson::Value& msg) const;
+   std::size_t size() const;
+
+   // index of the route of topic, in the order added, -1 if not routed
+   int route(const message_peek::field& topic) const;
+   const std::string& topic(int route) const { return routes_[route].first; }
+   void dispatch(int route, const rapidjson::Value& msg) const { routes_[route].second(msg); }
+
+private:
+   // few subscriptions: a linear scan beats hashing a topic per message
+   std::vector<std::pair<std::string, handler>> routes_;
+};
@@ -0,0 +1,119 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#include <cmath>
+
+#include "rapidjson/internal/dtoa.h"
+
+#include "message_template.hpp"
+
+message_template::message_template(encoding enc)
+   : encoding_(enc)
+{
+}
+
+message_template::encoding message_template::format() const
+{
+   return encoding_;
+}
+
+std::size_t message_template::slots() const
+{
+   return parts_.empty() ? 0 : parts_.size() - 1;
+}
+
+std::size_t message_template::size() const
+{
+   return size_;
+}
+
+const std::string& message_template::part(std::size_t i) const
+{
+   return parts_[i];
+}
+
+void message_template::add_part(std::string part)
+{
+   size_ += part.size();
+   parts_.push_back(std::move(part));
+}
+
+void message_template::append_number(std::string& out, double value) const
+{
+   if (encoding_ == encoding::cbor) {
+      cbor_writer writer(out);
+      writer.Double(value);
+      return;
+   }
+   // json has no representation for NaN and infinity
+   if (!std::isfinite(value)) {
+      out += "null";
+      return;
+   }
+   char buffer[32];
+   char* end = rapidjson::internal::dtoa(value, buffer);
+   out.append(buffer, end - buffer);
+}
+
+void message_template::append_text(std::string& out, const char* text, std::size_t length) const
+{
+   if (encoding_ == encoding::cbor) {
+      cbor_writer writer(out);
+      writer.String(text, (unsigned)length);
+      return;
+   }
+   static const char hex[] = "0123456789abcdef";
+   out += '"';
+   for (std::size_t i = 0; i < length; ++i) {
+      unsigned char c = (unsigned char)text[i];
+      if (c == '"' || c == '\\') {
+         out += '\\';
+         out += (char)c;
+      } else if (c < 0x20) {
+         out += "\\u00";
+         out += hex[c >> 4];
+         out += hex[c & 0xf];
+      } else {
+         out += (char)c;
+      }
+   }
+   out += '"';
+}
+
+void message_template::append_separator(std::string& out) const
+{
+   // cbor arrays are indefinite length, items follow each other directly
+   if (encoding_ == encoding::json) out += ',';
+}
+
+template_fill::template_fill(const message_template& tmpl, std::string& out)
+   : template_(tmpl)
+   , out_(out)
+{
+   out_ += template_.part(0);
+}
+
+template_fill& template_fill::number(double value)
+{
+   template_.append_number(out_, value);
+   out_ += template_.part(next_++);
+   return *this;
+}
+
+template_fill& template_fill::text(const std::string& value)
+{
+   return text(value.data(), value.size());
+}
+
+template_fill& template_fill::text(const char* value, std::size_t length)
+{
+   template_.append_text(out_, value, length);
+   out_ += template_.part(next_++);
+   return *this;
+}
+
+template_fill& template_fill::splice()
+{
+   out_ += template_.part(next_++);
+   return *this;
+}
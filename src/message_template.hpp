@@ -0,0 +1,155 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "rapidjson/writer.h"
+
+#include "cbor.hpp"
+
+// output stream for rapidjson writers appending to a message string
+struct string_output {
+   typedef char Ch;
+   std::string& out;
+   void Put(char c) { out.push_back(c); }
+   void Flush() {}
+};
+
+typedef rapidjson::Writer<string_output> json_writer;
+
+/**
+ * @brief Message_Template is an outgoing message serialized ahead of time,
+ * with slots for the values that change from message to message.
+ *
+ * Templates are compiled at startup by running a serializer against a
+ * template_builder, which marks where the slots are. Rendering a template
+ * copies the literal parts and formats only the slot values, so the message
+ * structure, topic and field names are not serialized again per message.
+ */
+class message_template
+{
+public:
+   enum class encoding { json, cbor };
+
+   message_template() = default;
+   explicit message_template(encoding enc);
+
+   // compile a template. serialize is called with a template_builder.
+   template <typename Serializer>
+   static message_template compile(encoding enc, Serializer serialize);
+
+   encoding format() const;
+   std::size_t slots() const;
+   std::size_t size() const;   // length of the literal parts
+   const std::string& part(std::size_t i) const;
+
+   // value formatting for slots: shortest round-trip numbers, quoted text
+   void append_number(std::string& out, double value) const;
+   void append_text(std::string& out, const char* text, std::size_t length) const;
+   // separator between items spliced into an array
+   void append_separator(std::string& out) const;
+
+   void add_part(std::string part);
+
+private:
+   encoding encoding_ = encoding::json;
+   std::vector<std::string> parts_;
+   std::size_t size_ = 0;
+};
+
+/**
+ * @brief Template_Fill renders a message_template into a message, one slot
+ * after the other.
+ *
+ * For splice slots the caller appends already encoded content (e.g. the
+ * items of an array) to the message and then calls splice().
+ */
+class template_fill
+{
+   const message_template& template_;
+   std::string& out_;
+   std::size_t next_ = 1;
+
+public:
+   template_fill(const message_template& tmpl, std::string& out);
+
+   template_fill& number(double value);
+   template_fill& text(const std::string& value);
+   template_fill& text(const char* value, std::size_t length);
+   template_fill& splice();
+};
+
+/**
+ * @brief Template_Builder forwards a serializer to a json or cbor writer and
+ * records the slot positions while the template is compiled.
+ */
+template <typename W>
+class template_builder
+{
+   W& writer_;
+   std::string& out_;
+   message_template& template_;
+   std::size_t cut_ = 0;
+
+   void cut()
+   {
+      template_.add_part(out_.substr(cut_));
+      cut_ = out_.size();
+   }
+
+   // json needs the separator of the value written before the slot
+   static void prefix(json_writer& w, rapidjson::Type type) { w.RawValue("", 0, type); }
+   static void prefix(cbor_writer&, rapidjson::Type) {}
+
+public:
+   template_builder(W& writer, std::string& out, message_template& tmpl)
+      : writer_(writer), out_(out), template_(tmpl) {}
+
+   // a number slot
+   void Slot() { prefix(writer_, rapidjson::kNumberType); cut(); }
+   // a text slot
+   void TextSlot() { prefix(writer_, rapidjson::kStringType); cut(); }
+   // content appended by the caller, e.g. the items of an open array
+   void Splice() { cut(); }
+
+   void finish() { cut(); }
+
+   bool Null() { return writer_.Null(); }
+   bool Bool(bool b) { return writer_.Bool(b); }
+   bool Int(int i) { return writer_.Int(i); }
+   bool Uint(unsigned u) { return writer_.Uint(u); }
+   bool Int64(int64_t i) { return writer_.Int64(i); }
+   bool Uint64(uint64_t u) { return writer_.Uint64(u); }
+   bool Double(double d) { return writer_.Double(d); }
+   template <typename... A> bool String(A&&... a) { return writer_.String(std::forward<A>(a)...); }
+   template <typename... A> bool Key(A&&... a) { return writer_.Key(std::forward<A>(a)...); }
+   bool StartObject() { return writer_.StartObject(); }
+   bool EndObject() { return writer_.EndObject(); }
+   bool StartArray() { return writer_.StartArray(); }
+   bool EndArray() { return writer_.EndArray(); }
+};
+
+template <typename Serializer>
+message_template message_template::compile(encoding enc, Serializer serialize)
+{
+   message_template tmpl(enc);
+   std::string out;
+   if (enc == encoding::cbor) {
+      cbor_writer writer(out);
+      template_builder<cbor_writer> builder(writer, out, tmpl);
+      serialize(builder);
+      builder.finish();
+   } else {
+      string_output os{out};
+      json_writer writer(os);
+      template_builder<json_writer> builder(writer, out, tmpl);
+      serialize(builder);
+      builder.finish();
+   }
+   return tmpl;
+}
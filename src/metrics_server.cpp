@@ -0,0 +1,125 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#include <algorithm>
+#include <vector>
+
+#include "amm/BaseLogger.h"
+#include "metrics_server.hpp"
+
+// one scrape connection. Requests are answered in turn, the response body
+// buffer is kept for the next scrape.
+class metrics_server::connection : public std::enable_shared_from_this<metrics_server::connection>
+{
+public:
+   connection(tcp::socket socket, std::shared_ptr<metrics_server> server)
+      : stream_(std::move(socket))
+      , server_(std::move(server))
+   {
+   }
+
+   void read()
+   {
+      request_ = {};
+      // an idle scraper is disconnected after a minute
+      stream_.expires_after(std::chrono::seconds(60));
+      http::async_read(stream_, buffer_, request_,
+         [self = shared_from_this()](error_code ec, std::size_t) { self->on_read(ec); });
+   }
+
+   void close()
+   {
+      stream_.close();
+   }
+
+private:
+   beast::tcp_stream stream_;
+   beast::flat_buffer buffer_;
+   http::request<http::empty_body> request_;
+   http::response<http::string_body> response_;
+   std::shared_ptr<metrics_server> server_;
+
+   void on_read(error_code ec)
+   {
+      if (ec) {
+         stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
+         return;
+      }
+      response_.version(request_.version());
+      response_.keep_alive(request_.keep_alive());
+      response_.body().clear();
+      bool found = request_.method() == http::verb::get && request_.target() == "/metrics";
+      if (found) {
+         response_.result(http::status::ok);
+         response_.set(http::field::content_type, "text/plain; version=0.0.4");
+         server_->handler_(response_.body());
+      } else {
+         response_.result(http::status::not_found);
+         response_.set(http::field::content_type, "text/plain");
+         response_.body() = "not found\n";
+      }
+      response_.prepare_payload();
+      http::async_write(stream_, response_,
+         [self = shared_from_this()](error_code ec, std::size_t) { self->on_write(ec); });
+   }
+
+   void on_write(error_code ec)
+   {
+      if (ec || !response_.keep_alive()) {
+         stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
+         return;
+      }
+      read();
+   }
+};
+
+metrics_server::metrics_server(net::io_context& ioc, handler h)
+   : ioc_(ioc)
+   , acceptor_(ioc)
+   , handler_(std::move(h))
+{
+}
+
+bool metrics_server::start(const std::string& address, unsigned short port)
+{
+   error_code ec;
+   tcp::endpoint endpoint(net::ip::make_address(address, ec), port);
+   if (!ec) acceptor_.open(endpoint.protocol(), ec);
+   if (!ec) acceptor_.set_option(net::socket_base::reuse_address(true), ec);
+   if (!ec) acceptor_.bind(endpoint, ec);
+   if (!ec) acceptor_.listen(net::socket_base::max_listen_connections, ec);
+   if (ec) {
+      LOG_ERROR << "Metrics endpoint " << address << ":" << port << ": " << ec.message();
+      return false;
+   }
+   accept();
+   return true;
+}
+
+void metrics_server::stop()
+{
+   net::post(ioc_, [self = shared_from_this()]() {
+      error_code ec;
+      self->acceptor_.close(ec);
+      // scrapers keep their connections open, which would keep run() going
+      for (const std::weak_ptr<connection>& w : self->connections_)
+         if (auto c = w.lock()) c->close();
+      self->connections_.clear();
+   });
+}
+
+void metrics_server::accept()
+{
+   acceptor_.async_accept([self = shared_from_this()](error_code ec, tcp::socket socket) {
+      if (ec == net::error::operation_aborted) return;
+      if (!ec) {
+         auto c = std::make_shared<connection>(std::move(socket), self);
+         auto& open = self->connections_;
+         open.erase(std::remove_if(open.begin(), open.end(),
+                                   [](const std::weak_ptr<connection>& w) { return w.expired(); }), open.end());
+         open.push_back(c);
+         c->read();
+      }
+      self->accept();
+   });
+}
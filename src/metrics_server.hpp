@@ -0,0 +1,42 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ros_session.hpp"
+
+/**
+ * @brief Metrics_Server answers HTTP GET /metrics with the text rendered by
+ * its handler, for Prometheus to scrape.
+ *
+ * It runs on the io_context of the bridge, so the handler runs on the I/O
+ * thread and may read what only that thread writes. Connections are kept
+ * alive between scrapes; anything but GET /metrics gets a 404.
+ */
+class metrics_server : public std::enable_shared_from_this<metrics_server>
+{
+public:
+   // append the response body to out
+   typedef std::function<void(std::string& out)> handler;
+
+   metrics_server(net::io_context& ioc, handler h);
+
+   // listen on address:port. Returns false if the port can not be bound.
+   bool start(const std::string& address, unsigned short port);
+   void stop();
+
+private:
+   class connection;
+
+   net::io_context& ioc_;
+   tcp::acceptor acceptor_;
+   handler handler_;
+   std::vector<std::weak_ptr<connection>> connections_;
+
+   void accept();
+};
@@ -0,0 +1,192 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+#include "physmod_translator.hpp"
+#include "ros_messages.hpp"
+
+namespace {
+
+bool is_space(char c)
+{
+   return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+const char* skip_space(const char* p, const char* end)
+{
+   while (p < end && is_space(*p)) ++p;
+   return p;
+}
+
+bool starts_with(const char* p, const char* end, const char* s)
+{
+   std::size_t n = std::strlen(s);
+   return (std::size_t)(end - p) >= n && std::memcmp(p, s, n) == 0;
+}
+
+}
+
+bool physmod_translator::text_span::is(const std::string& s) const
+{
+   return length == s.size() && std::memcmp(data, s.data(), length) == 0;
+}
+
+physmod_translator::type_id physmod_translator::add(const modification_mapping& mapping, message_template::encoding enc)
+{
+   type_id existing = find(mapping.type.data(), mapping.type.size());
+   if (existing != invalid_id) return existing;
+
+   translator t;
+   t.mapping = mapping;
+   t.tmpl = ros::compile(enc, ros::publish(mapping.topic, ros::modification_msg{mapping.type, mapping.params}));
+   translators_.push_back(std::move(t));
+   elements_.reserve(16);
+   return (type_id)translators_.size() - 1;
+}
+
+physmod_translator::type_id physmod_translator::find(const char* type, std::size_t length) const
+{
+   for (std::size_t i = 0; i < translators_.size(); ++i) {
+      const std::string& t = translators_[i].mapping.type;
+      if (t.size() == length && strncasecmp(t.data(), type, length) == 0) return (type_id)i;
+   }
+   return invalid_id;
+}
+
+physmod_translator::type_id physmod_translator::translate(const std::string& type, const std::string& payload, std::string& message)
+{
+   text_span payloadType = {type.data(), type.size()};
+   if (scan(payload, payloadType)) {
+      ++scanned_;
+   } else {
+      payloadType = {type.data(), type.size()};
+      if (!parse(payload, payloadType)) return invalid_id;
+      ++parsed_;
+   }
+
+   type_id id = find(payloadType.data, payloadType.length);
+   if (id == invalid_id) return invalid_id;
+
+   const translator& t = translators_[id];
+   message.clear();
+   template_fill fill(t.tmpl, message);
+   for (const modification_param& param : t.mapping.params) {
+      const text_span* value = nullptr;
+      for (const element& e : elements_)
+         if (e.name.is(param.element)) { value = &e.text; break; }
+
+      if (param.text) {
+         if (value) {
+            // trim the element text
+            const char* begin = skip_space(value->data, value->data + value->length);
+            const char* end = value->data + value->length;
+            while (end > begin && is_space(end[-1])) --end;
+            fill.text(begin, end - begin);
+         } else {
+            fill.text(param.fallback);
+         }
+      } else {
+         // element texts end at '<' or '\0', so strtod stops within them
+         char* end = nullptr;
+         double number = value ? std::strtod(value->data, &end) : 0.0;
+         if (!value || end == value->data)
+            number = std::strtod(param.fallback.c_str(), nullptr);
+         fill.number(number);
+      }
+   }
+   return id;
+}
+
+// read a flat payload in place: an optional prolog, the root element with
+// its type attribute, and children <Name>text</Name> without attributes.
+// Returns false for anything else.
+bool physmod_translator::scan(const std::string& payload, text_span& type)
+{
+   elements_.clear();
+   const char* p = payload.data();
+   const char* end = p + payload.size();
+
+   p = skip_space(p, end);
+   if (starts_with(p, end, "<?")) {
+      const char* close = std::strstr(p, "?>");
+      if (!close || close >= end) return false;
+      p = skip_space(close + 2, end);
+   }
+
+   // root element and its attributes
+   if (p >= end || *p != '<') return false;
+   ++p;
+   while (p < end && !is_space(*p) && *p != '>' && *p != '/') ++p;
+   for (;;) {
+      p = skip_space(p, end);
+      if (p >= end) return false;
+      if (*p == '>') { ++p; break; }
+      if (starts_with(p, end, "/>")) return true;
+      const char* name = p;
+      while (p < end && *p != '=' && !is_space(*p)) ++p;
+      std::size_t nameLength = p - name;
+      p = skip_space(p, end);
+      if (p >= end || *p != '=') return false;
+      p = skip_space(p + 1, end);
+      if (p >= end || (*p != '"' && *p != '\'')) return false;
+      char quote = *p++;
+      const char* value = p;
+      while (p < end && *p != quote) ++p;
+      if (p >= end) return false;
+      if (nameLength == 4 && std::memcmp(name, "type", 4) == 0) {
+         if (std::memchr(value, '&', p - value)) return false;
+         type = {value, (std::size_t)(p - value)};
+      }
+      ++p;
+   }
+
+   // children
+   for (;;) {
+      p = skip_space(p, end);
+      if (p >= end) return false;
+      if (starts_with(p, end, "</")) return true;
+      if (*p != '<' || starts_with(p, end, "<!") || starts_with(p, end, "<?")) return false;
+      element e;
+      e.name.data = ++p;
+      while (p < end && *p != '>' && *p != '/' && !is_space(*p)) ++p;
+      e.name.length = p - e.name.data;
+      if (starts_with(p, end, "/>")) {
+         e.text = {p, 0};
+         elements_.push_back(e);
+         p += 2;
+         continue;
+      }
+      if (p >= end || *p != '>') return false;
+      e.text.data = ++p;
+      while (p < end && *p != '<' && *p != '&') ++p;
+      if (p >= end || *p == '&') return false;
+      e.text.length = p - e.text.data;
+      if (!starts_with(p, end, "</")) return false;
+      p += 2;
+      if ((std::size_t)(end - p) < e.name.length + 1 || std::memcmp(p, e.name.data, e.name.length) != 0 || p[e.name.length] != '>')
+         return false;
+      p += e.name.length + 1;
+      elements_.push_back(e);
+   }
+}
+
+// payloads the scan does not handle, with the reused document
+bool physmod_translator::parse(const std::string& payload, text_span& type)
+{
+   elements_.clear();
+   doc_.Parse(payload.c_str(), payload.size());
+   if (doc_.ErrorID() != 0) return false;
+   const tinyxml2::XMLElement* root = doc_.FirstChildElement();
+   if (!root) return false;
+   if (const char* t = root->Attribute("type"))
+      type = {t, std::strlen(t)};
+   for (const tinyxml2::XMLElement* e = root->FirstChildElement(); e; e = e->NextSiblingElement()) {
+      const char* text = e->GetText();
+      if (!text) text = "";
+      elements_.push_back({{e->Name(), std::strlen(e->Name())}, {text, std::strlen(text)}});
+   }
+   return true;
+}
@@ -0,0 +1,74 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "tinyxml2.h"
+
+#include "bridge_config.hpp"
+#include "message_template.hpp"
+
+/**
+ * @brief Physmod_Translator turns AMM physiology modifications into ROS
+ * messages, one translator per configured modification type.
+ *
+ * Types are interned when the translators are added; a received type is
+ * matched case insensitively against them without copying it. Payloads are
+ * usually flat, <PhysiologyModification type=".."><Severity>0.5</Severity>
+ * </PhysiologyModification>, and are read with a scan that records where
+ * the element texts are, without building a document. Anything else
+ * (nested elements, entities, comments) is parsed with a tinyxml2 document
+ * kept for reuse. Messages are rendered from templates compiled at setup.
+ *
+ * Not thread safe: call translate() from one thread, the I/O thread.
+ */
+class physmod_translator
+{
+public:
+   typedef int type_id;
+   static const type_id invalid_id = -1;
+
+   // setup time only
+   type_id add(const modification_mapping& mapping, message_template::encoding enc);
+   std::size_t size() const { return translators_.size(); }
+   const std::string& type(type_id id) const { return translators_[id].mapping.type; }
+   const std::string& topic(type_id id) const { return translators_[id].mapping.topic; }
+
+   type_id find(const char* type, std::size_t length) const;
+
+   // render the ROS message for payload into message. type is used if the
+   // payload does not name one. Returns the translator, invalid_id if the
+   // type is not mapped or the payload can not be read.
+   type_id translate(const std::string& type, const std::string& payload, std::string& message);
+
+   std::size_t scanned() const { return scanned_; }
+   std::size_t parsed() const { return parsed_; }
+
+private:
+   struct text_span {
+      const char* data;
+      std::size_t length;
+      bool is(const std::string& s) const;
+   };
+   struct element {
+      text_span name;
+      text_span text;
+   };
+   struct translator {
+      modification_mapping mapping;
+      message_template tmpl;
+   };
+
+   std::vector<translator> translators_;
+   std::vector<element> elements_;   // children of the current payload
+   tinyxml2::XMLDocument doc_;
+   std::size_t scanned_ = 0;
+   std::size_t parsed_ = 0;
+
+   bool scan(const std::string& payload, text_span& type);
+   bool parse(const std::string& payload, text_span& type);
+};
@@ -0,0 +1,57 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#include "publish_scheduler.hpp"
+
+namespace net = boost::asio;
+using std::chrono::steady_clock;
+
+publish_scheduler::publish_scheduler(net::io_context& ioc)
+   : strand_(net::make_strand(ioc))
+{
+}
+
+void publish_scheduler::add(double rate, task t)
+{
+   if (rate <= 0.0) return;
+   auto period = std::chrono::duration_cast<steady_clock::duration>(std::chrono::duration<double>(1.0 / rate));
+   tasks_.emplace_back(new entry(strand_, period, std::move(t)));
+}
+
+void publish_scheduler::start()
+{
+   net::post(strand_, [this]() {
+      stopped_ = false;
+      steady_clock::time_point now = steady_clock::now();
+      for (auto& e : tasks_) {
+         e->deadline = now + e->period;
+         schedule(*e);
+      }
+   });
+}
+
+void publish_scheduler::stop()
+{
+   net::post(strand_, [this]() {
+      stopped_ = true;
+      for (auto& e : tasks_)
+         e->timer.cancel();
+   });
+}
+
+void publish_scheduler::schedule(entry& e)
+{
+   e.timer.expires_at(e.deadline);
+   e.timer.async_wait([this, &e](const boost::system::error_code& ec) {
+      if (ec || stopped_) return;
+      e.run();
+
+      e.deadline += e.period;
+      steady_clock::time_point now = steady_clock::now();
+      if (e.deadline < now) {
+         // fell behind, e.g. the host was suspended. skip the missed calls.
+         e.deadline = now + e.period;
+      }
+      schedule(e);
+   });
+}
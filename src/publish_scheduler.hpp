@@ -0,0 +1,51 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+/**
+ * @brief Publish_Scheduler Class calls publish tasks at fixed wall clock
+ * rates on a strand of the io_context.
+ *
+ * Each task has its own steady_timer. Deadlines advance by the period, so
+ * the rate does not drift with handler latency; a task that falls more than
+ * a period behind skips the missed calls instead of bursting.
+ */
+class publish_scheduler
+{
+public:
+   typedef std::function<void()> task;
+
+   explicit publish_scheduler(boost::asio::io_context& ioc);
+
+   // call t rate times per second. Call before start().
+   void add(double rate, task t);
+   std::size_t size() const { return tasks_.size(); }
+
+   void start();
+   void stop();
+
+private:
+   struct entry {
+      std::chrono::steady_clock::duration period;
+      std::chrono::steady_clock::time_point deadline;
+      boost::asio::steady_timer timer;
+      task run;
+      entry(boost::asio::strand<boost::asio::io_context::executor_type>& strand,
+            std::chrono::steady_clock::duration p, task t)
+         : period(p), timer(strand), run(std::move(t)) {}
+   };
+
+   boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+   std::vector<std::unique_ptr<entry>> tasks_;
+   bool stopped_ = true;
+
+   void schedule(entry& e);
+};
@@ -7,19 +7,41 @@
 #include <iostream>
 #include <cmath>
 #include <sstream>
+#include <unordered_map>
+#include <cstring>
+#include <algorithm>
+#include <iomanip>
 
 #include <amm_std.h>
 #include <signal.h>
+#include <pthread.h>
 #include "amm/BaseLogger.h"
 
 /// json library
 #include "rapidjson/document.h"
 #include "rapidjson/writer.h"
+#include "rapidjson/stringbuffer.h"
 
 /// xml library
 #include "tinyxml2.h"
 
-#include "websocket_session.hpp"
+#include "ros_endpoint.hpp"
+#include "ros_publisher.hpp"
+#include "publish_scheduler.hpp"
+#include "ingest_pipeline.hpp"
+#include "latency_tracer.hpp"
+#include "message_template.hpp"
+#include "ros_messages.hpp"
+#include "bridge_config.hpp"
+#include "signal_registry.hpp"
+#include "waveform_buffer.hpp"
+#include "message_router.hpp"
+#include "capture_file.hpp"
+#include "physmod_translator.hpp"
+#include "service_caller.hpp"
+#include "fragment_assembler.hpp"
+#include "bridge_metrics.hpp"
+#include "metrics_server.hpp"
 
 extern "C" {
    #include "cl_arguments.c"
@@ -33,126 +55,424 @@ using namespace tinyxml2;
 // declare DDSManager for this module
 const std::string moduleName = "ROS Bridge";
 const std::string configFile = "config/ros_bridge_amm.xml";
-AMM::DDSManager<void>* mgr = new AMM::DDSManager<void>(configFile);
+AMM::DDSManager<void>* mgr = nullptr;   // created in main, while ROS connects
 AMM::UUID m_uuid;
 
-//std::mutex nds_mutex;
 //<DataRequest xsi:type="PhysiologyDataRequestData" Name="CerebralBloodFlow" Unit="mL/min"       Precision="3"/>
 //<DataRequest xsi:type="PhysiologyDataRequestData" Name="IntracranialPressure" Unit="mmHg"      Precision="3"/>
 //<DataRequest xsi:type="PhysiologyDataRequestData" Name="CerebralPerfusionPressure" Unit="mmHg" Precision="3"/>
-std::map<std::string, std::string> nodeDataStorage = {
-      {"Cardiovascular_HeartRate", "0"},
-      {"Cardiovascular_Arterial_Systolic_Pressure", "0"},
-      {"Cardiovascular_Arterial_Diastolic_Pressure", "0"},
-      {"BloodChemistry_Oxygen_Saturation", "0"},
-      {"Respiration_EndTidalCarbonDioxide", "0"},
-      {"Respiratory_Respiration_Rate", "0"},
-      {"Energy_Core_Temperature", "0"},
-      {"CerebralBloodFlow", "0"},
-      {"IntracranialPressure", "0"},
-      {"CerebralPerfusionPressure", "0"},
-      {"SIM_TIME", "0"},
+// phys values stored by the bridge. Names are interned at startup, values
+// of other signals are ignored.
+const std::vector<std::string> nodeDataSignals = {
+      "Cardiovascular_HeartRate",
+      "Cardiovascular_Arterial_Systolic_Pressure",
+      "Cardiovascular_Arterial_Diastolic_Pressure",
+      "BloodChemistry_Oxygen_Saturation",
+      "Respiration_EndTidalCarbonDioxide",
+      "Respiratory_Respiration_Rate",
+      "Energy_Core_Temperature",
+      "CerebralBloodFlow",
+      "IntracranialPressure",
+      "CerebralPerfusionPressure",
+      "SIM_TIME",
    };
+signal_registry nodeData;
+
+// AMM to ROS mapping, read from the <ROS> section of the configuration file.
+// --signals, --batch and --waveforms override it from the command line.
+const std::string bridgeConfigFile = "config/ros_bridge_configuration.xml";
+const std::string capabilitiesFile = "config/ros_bridge_capabilities.xml";
+bridge_config bridgeConfig;
+// read once at startup, published with the module description
+std::string configurationXml;
+std::string capabilitiesXml;
+
+// constant messages sent on events
+std::vector<std::pair<std::string, message_template>> eventMessages;
+
+// ROS to AMM: subscribe ops sent after the handshake and the handlers
+// their messages are routed to
+std::vector<message_template> subscribeMessages;
+std::vector<message_template> unsubscribeMessages;
+
+// topics published to, advertised with their type after every handshake
+// and unadvertised on shutdown
+struct topic_advertisement {
+   std::string topic;
+   std::string type;
+   message_template advertise;
+   message_template unadvertise;
+};
+std::vector<topic_advertisement> advertisements;
+
+// physiology modifications forwarded to ROS
+physmod_translator physmodTranslator;
+std::vector<int> physmodTraceTopics;
+message_router rosRouter;
 
-// initialize module state
+// initialize module state. Only used on the I/O thread.
 int sim_status = 0;  // 0 - initial/reset, 1 - running, 2 - paused
 int64_t lastTick = 0;
 
-// websocket session for asynchronous read/write to ROS instance
+// websocket sessions for asynchronous read/write to the ROS instances.
+// Each endpoint reconnects on its own; the work guard keeps the io_context
+// running while no session is active.
 net::io_context ioc;
-auto ws_session = std::make_shared<websocket_session>(ioc); 
-bool try_reconnect = true;
-bool websocket_connected = false;
+net::executor_work_guard<net::io_context::executor_type> iocWork = net::make_work_guard(ioc);
+ros_fanout rosFanout;
 bool ros_initialized = false;
 
+// ROS services called on events, many calls in flight at once
+service_caller serviceCaller(ioc, rosFanout);
+
+// messages rosbridge sent in fragments, joined per connection
+std::vector<std::shared_ptr<fragment_assembler>> fragmentAssemblers;
+
 const std::string target = "/";
 
+// message encoding on the ROS link, see --encoding
+bool useCbor = false;
+
+// latency of forwarded messages per stage and topic. kill -USR1 logs the
+// histograms and the last messages.
+latency_tracer tracer;
+net::signal_set traceSignals(ioc, SIGUSR1);
+
+// phys values and waveforms from AMM to ROS, compiled from the publish and
+// waveform mappings. Phys values are published on wall clock timers, each
+// at its own rate.
+ros_publisher rosPublisher(nodeData, rosFanout, tracer);
+publish_scheduler physScheduler(ioc);
+
+// counters served on --metrics-port and summarized on the AMM Status topic
+// every --status-interval seconds. Counted without locks on any thread.
+bridge_metrics metrics;
+struct traffic_counters {
+   bridge_metrics::counter_id messages = 0;
+   bridge_metrics::counter_id bytes = 0;
+};
+std::vector<traffic_counters> topicsOut;     // by tracer topic id
+traffic_counters opsOut;                     // advertise, subscribe, events, ...
+std::vector<traffic_counters> topicsIn;      // by rosRouter route
+std::vector<traffic_counters> endpointsIn;   // websocket messages as received
+bridge_metrics::counter_id parseErrors = 0;
+std::shared_ptr<metrics_server> metricsServer;
+net::steady_timer statusTimer(ioc);
+
+void countTraffic(const traffic_counters& counters, std::size_t bytes) {
+   metrics.add(counters.messages);
+   metrics.add(counters.bytes, bytes);
+}
+
+// startup. ROS connects while the DDS entities are created; subscriptions
+// to ROS topics, which are forwarded to AMM, wait until AMM is ready.
+steady_clock::time_point startupBegin;
+bool ammReady = false;   // I/O thread only
+net::steady_timer announceTimer(ioc);
+
+void logStartupPhase(const char* phase, steady_clock::time_point& since) {
+   auto now = steady_clock::now();
+   LOG_INFO << "Startup: " << phase << " " << duration_cast<milliseconds>(now - since).count()
+            << " ms (" << duration_cast<milliseconds>(now - startupBegin).count() << " ms total)";
+   since = now;
+}
+
+// serialize a parsed message back to text. used for logging only, the
+// in-situ parsed message buffer is no longer readable as a whole.
+template <typename Doc>
+std::string documentToString(const Doc& document) {
+   StringBuffer sb;
+   Writer<StringBuffer> writer(sb);
+   document.Accept(writer);
+   return std::string(sb.GetString(), sb.GetSize());
+}
+
+// compile the AMM to ROS mapping into message templates. Messages are
+// rendered from these templates; only values are formatted per message.
+void compileMessageTemplates(message_template::encoding enc) {
+   rosPublisher.compile(bridgeConfig, enc);
+
+   for (const event_mapping& event : bridgeConfig.events) {
+      eventMessages.emplace_back(event.type, ros::compile(enc, ros::publish(event.topic, ros::string_fields{event.fields})));
+   }
+
+   for (const modification_mapping& mapping : bridgeConfig.modifications) {
+      physmodTranslator.add(mapping, enc);
+      if (physmodTraceTopics.size() < physmodTranslator.size())
+         physmodTraceTopics.push_back(tracer.topic(mapping.topic));
+   }
+
+   for (const subscription_mapping& sub : bridgeConfig.subscribe) {
+      ros::subscribe_op subscribe{sub.topic};
+      subscribe.type = ros::unless_empty(sub.type);
+      subscribe.throttle_rate = ros::when_positive(sub.throttle_rate);
+      subscribe.queue_length = ros::when_positive(sub.queue_length);
+      subscribe.fragment_size = ros::when_positive(sub.fragment_size);
+      if (enc == message_template::encoding::cbor)
+         subscribe.compression = std::string("cbor");
+      subscribeMessages.push_back(ros::compile(enc, subscribe));
+      unsubscribeMessages.push_back(ros::compile(enc, ros::unsubscribe_op{sub.topic}));
+   }
+
+   // every topic with a known message type, once
+   auto advertise = [&](const std::string& topic, const std::string& type) {
+      if (topic.empty() || type.empty()) return;
+      for (const topic_advertisement& a : advertisements) {
+         if (a.topic != topic) continue;
+         if (a.type != type)
+            LOG_WARNING << "Topic " << topic << " configured as " << a.type << " and " << type << ", advertising " << a.type;
+         return;
+      }
+      topic_advertisement a;
+      a.topic = topic;
+      a.type = type;
+      a.advertise = ros::compile(enc, ros::advertise_op{topic, type});
+      a.unadvertise = ros::compile(enc, ros::unadvertise_op{topic});
+      advertisements.push_back(std::move(a));
+   };
+   for (const publish_mapping& mapping : bridgeConfig.publish)
+      advertise(mapping.topic, mapping.type);
+   if (rosPublisher.waveforms() > 0)
+      advertise(bridgeConfig.waveforms.topic, bridgeConfig.waveforms.type);
+   for (const event_mapping& event : bridgeConfig.events)
+      advertise(event.topic, event.message_type);
+   for (const modification_mapping& mapping : bridgeConfig.modifications)
+      advertise(mapping.topic, mapping.message_type);
+}
+
+void logMessage(const std::string& message) {
+   if ( arguments.verbose && !useCbor )
+      LOG_DEBUG << "Writing message to ROS: " << message;
+}
+
+// written messages are logged and counted per topic
+void onMessageWritten(int topic, const std::string& data) {
+   logMessage(data);
+   countTraffic(topic >= 0 && (std::size_t)topic < topicsOut.size() ? topicsOut[topic] : opsOut, data.size());
+}
+
+// write a message rendered into a pooled message from rosFanout.acquire()
+// to all connected ROS instances, or only to endpoint if given
+void writeMessage(std::shared_ptr<outbound_message> message, int key = -1, ros_endpoint* endpoint = nullptr,
+                  message_trace trace = message_trace()) {
+   rosPublisher.write(std::move(message), key, endpoint, trace);
+}
+
 //write data packets to websocket
-void writeTestPacket() {
+// event messages to all ROS instances, or only to endpoint if given
+void writeEventPacket(const std::string& type, ros_endpoint* endpoint = nullptr) {
    // MoHSES - ROS - first contact!
-   std::string message = "{\"op\":\"publish\",\"topic\":\"/hr/control/speech/say\",\"msg\": {\"text\": \"MoHSES connected via ros-bridge\"}}";
-   LOG_DEBUG << "Writing message to ROS: " << message;
-   ws_session->do_write(message);
-}
-
-void writePhysDataPacket() {
-   // forward relevant phys data to ROS/Sophia
-   std::string message;
-   //std::string message = "{\"op\":\"publish\",\"topic\":\"/hr/control/speech/say\",\"msg\": {\"text\": \"My heart rate is " + nodeDataStorage["Cardiovascular_HeartRate"] + " bpm.\"}}";
-
-   // publish each phys value as a separate message
-   // heart rate
-   message = "{\"op\":\"publish\",\"topic\":\"/hr/physiology\",\"msg\": {\"physiologyvalue\": {\"name\":\"Cardiovascular_HeartRate\",\"value\":"\
-      + nodeDataStorage["Cardiovascular_HeartRate"] + "}}}";
-   LOG_DEBUG << "Writing message to ROS: " << message;
-   ws_session->do_write(message);
-
-   // cerebral blood flow
-   message = "{\"op\":\"publish\",\"topic\":\"/hr/physiology\",\"msg\": {\"physiologyvalue\": {\"name\":\"CerebralBloodFlow\",\"value\":"\
-   + nodeDataStorage["CerebralBloodFlow"] + "}}}";
-   LOG_DEBUG << "Writing message to ROS: " << message;
-   ws_session->do_write(message);
-
-   // inracranial pressure
-   message = "{\"op\":\"publish\",\"topic\":\"/hr/physiology\",\"msg\": {\"physiologyvalue\": {\"name\":\"IntracranialPressure\",\"value\":"\
-   + nodeDataStorage["IntracranialPressure"] + "}}}";
-   LOG_DEBUG << "Writing message to ROS: " << message;
-   ws_session->do_write(message);
-
-   //cerebral perfusion pressure
-   message = "{\"op\":\"publish\",\"topic\":\"/hr/physiology\",\"msg\": {\"physiologyvalue\": {\"name\":\"CerebralPerfusionPressure\",\"value\":"\
-   + nodeDataStorage["CerebralPerfusionPressure"] + "}}}";
-   LOG_DEBUG << "Writing message to ROS: " << message;
-   ws_session->do_write(message);
+   for (const auto& event : eventMessages) {
+      if (event.first != type) continue;
+      std::shared_ptr<outbound_message> message = rosFanout.acquire();
+      template_fill(event.second, message->data);
+      writeMessage(std::move(message), -1, endpoint);
+   }
+}
+
+// call the services configured for an event, on endpoint if given. The
+// calls do not wait for each other, responses are only logged.
+void callEventServices(const std::string& event, ros_endpoint* endpoint = nullptr) {
+   for (const service_mapping& mapping : bridgeConfig.services) {
+      if (mapping.event != event) continue;
+      const std::string& service = mapping.service;
+      serviceCaller.call(service, mapping.type, ros::string_fields{mapping.args}, milliseconds(mapping.timeout),
+         [&service](service_status status, const Value& values) {
+            if (status == service_status::succeeded) {
+               if ( arguments.verbose )
+                  LOG_DEBUG << "ROS service " << service << " succeeded";
+            } else {
+               LOG_WARNING << "ROS service " << service << " " << service_status_name(status)
+                           << (values.IsString() ? ": " : "") << (values.IsString() ? values.GetString() : "");
+            }
+         }, endpoint);
+   }
+}
+
+void writeAdvertisePackets(ros_endpoint& endpoint) {
+   for (const topic_advertisement& a : advertisements) {
+      std::shared_ptr<outbound_message> message = rosFanout.acquire();
+      template_fill(a.advertise, message->data);
+      writeMessage(std::move(message), -1, &endpoint);
+   }
+}
+
+// leave the ROS graph tidy: queued before the sessions close, which sends
+// what is queued
+void writeShutdownPackets() {
+   for (const message_template& unsubscribe : unsubscribeMessages) {
+      std::shared_ptr<outbound_message> message = rosFanout.acquire();
+      template_fill(unsubscribe, message->data);
+      writeMessage(std::move(message));
+   }
+   for (const topic_advertisement& a : advertisements) {
+      std::shared_ptr<outbound_message> message = rosFanout.acquire();
+      template_fill(a.unadvertise, message->data);
+      writeMessage(std::move(message));
+   }
+}
+
+void writeSubscribePackets(ros_endpoint& endpoint) {
+   for (const message_template& subscribe : subscribeMessages) {
+      std::shared_ptr<outbound_message> message = rosFanout.acquire();
+      template_fill(subscribe, message->data);
+      writeMessage(std::move(message), -1, &endpoint);
+   }
+}
+
+// text of a field of a ROS message. strings are forwarded as they are,
+// other values as json.
+std::string messageFieldText(const Value& msg, const std::string& field) {
+   if (!msg.IsObject()) return std::string();
+   Value::ConstMemberIterator it = msg.FindMember(field.c_str());
+   if (it == msg.MemberEnd()) return std::string();
+   if (it->value.IsString()) return std::string(it->value.GetString(), it->value.GetStringLength());
+   return documentToString(it->value);
+}
+
+// route the messages of the configured ROS subscriptions to AMM
+void registerSubscriptionHandlers() {
+   for (const subscription_mapping& sub : bridgeConfig.subscribe) {
+      if (sub.handler == "command") {
+         rosRouter.add(sub.topic, [sub](const Value& msg) {
+            AMM::Command command;
+            command.message(messageFieldText(msg, sub.field));
+            if ( arguments.verbose )
+               LOG_DEBUG << "ROS " << sub.topic << " -> AMM Command: " << command.message();
+            mgr->WriteCommand(command);
+         });
+      } else if (sub.handler == "render_modification") {
+         rosRouter.add(sub.topic, [sub](const Value& msg) {
+            AMM::RenderModification renderMod;
+            renderMod.type(sub.render_type);
+            renderMod.data(messageFieldText(msg, sub.field));
+            if ( arguments.verbose )
+               LOG_DEBUG << "ROS " << sub.topic << " -> AMM RenderModification: " << renderMod.type();
+            mgr->WriteRenderModification(renderMod);
+         });
+      }
+   }
 }
 
 // callback function for new data on websocket
-void onNewWebsocketMessage(const std::string body) {
-   // parse web socket message as json data
-   std::string type;
-   Document document;
-   document.Parse(body.c_str());
-
-   if (document.HasMember("type") && document["type"].IsString()) {
-      type = document["type"].GetString();
-      if (type.compare("ros_topic") == 0) {
-         // ignore. only log message type
-         LOG_DEBUG << "ros message: {\"type\": \"ros_topic\", ...}";
-         return;
+// msg is a view into the websocket receive buffer, null terminated and only
+// valid during the call. Text messages are parsed in place and modified by
+// the parser, binary messages are decoded as cbor. Fragments are joined by
+// the assembler of the connection, which passes the whole message back in.
+void onNewWebsocketMessage(net::mutable_buffer msg, bool binary, fragment_assembler* fragments) {
+   // read the envelope first. publishes on topics without a handler are
+   // dropped here, before a document is built.
+   message_peek peek;
+   if (!peek.peek(static_cast<const char*>(msg.data()), msg.size(), binary)) {
+      metrics.add(parseErrors);
+      LOG_ERROR << "ROS message (parse error)";
+      return;
+   }
+   if (peek.type.is("ros_topic")) {
+      // ignore. only log message type
+      LOG_DEBUG << "ros message: {\"type\": \"ros_topic\", ...}";
+      return;
+   }
+   if (peek.op.is("fragment")) {
+      if (!fragments || !fragments->add(static_cast<char*>(msg.data()), msg.size(), binary)) {
+         metrics.add(parseErrors);
+         LOG_ERROR << "ROS message (malformed fragment)";
       }
-      LOG_DEBUG << "ROS message: " << body ;
+      return;
+   }
+   bool publish = peek.op.is("publish");
+   int route = publish ? rosRouter.route(peek.topic) : -1;
+   if (publish && route < 0) return;
+   if (publish) countTraffic(topicsIn[route], msg.size());
+   // responses to calls that timed out or were made by other clients
+   bool serviceResponse = peek.op.is("service_response");
+   if (serviceResponse && !serviceCaller.expects(peek.id)) return;
+
+   // parse web socket message without copying it. Small messages are parsed
+   // without heap allocation using the stack buffers below.
+   char valueBuffer[4096];
+   char parseBuffer[1024];
+   MemoryPoolAllocator<> valueAllocator(valueBuffer, sizeof(valueBuffer));
+   MemoryPoolAllocator<> parseAllocator(parseBuffer, sizeof(parseBuffer));
+   GenericDocument<UTF8<>, MemoryPoolAllocator<>, MemoryPoolAllocator<> > document(&valueAllocator, sizeof(parseBuffer), &parseAllocator);
+   if ( binary ) {
+      auto decode = [&msg](auto& handler) { return cbor_parse(msg.data(), msg.size(), handler); };
+      document.Populate(decode);
+   } else {
+      document.ParseInsitu(static_cast<char*>(msg.data()));
+   }
+
+   if (document.HasParseError()) {
+      metrics.add(parseErrors);
+      LOG_ERROR << "ROS message (parse error " << document.GetParseError() << " at " << document.GetErrorOffset() << ")";
+      return;
+   }
+
+   if (publish) {
+      if (document.HasMember("msg"))
+         rosRouter.dispatch(route, document["msg"]);
+      return;
+   }
+   if (serviceResponse) {
+      serviceCaller.complete(peek.id, document);
+      return;
+   }
+
+   if (peek.op.present || peek.type.present) {
+      LOG_DEBUG << "ROS message: " << documentToString(document);
    } else {
-      LOG_ERROR << "ROS message (no type): " << body ;
+      LOG_ERROR << "ROS message (no op): " << documentToString(document);
    }
 }
 
 // init ROS comms 
-void onWebsocketHandshake(const std::string body) {
-   websocket_connected = true;
-   writeTestPacket();
+void onWebsocketHandshake(ros_endpoint& endpoint) {
+   static bool first = true;
+   if ( first ) {
+      first = false;
+      LOG_INFO << "Startup: first ROS handshake after "
+               << duration_cast<milliseconds>(steady_clock::now() - startupBegin).count() << " ms";
+   }
+   // advertise before the first publish, again on every new connection as
+   // the rosbridge server forgets them with the client
+   writeAdvertisePackets(endpoint);
+   if ( ammReady ) writeSubscribePackets(endpoint);
+   writeEventPacket("connect", &endpoint);
+   callEventServices("connect", &endpoint);
+   // resume with the latest values instead of waiting for the next update
+   rosPublisher.write_phys_data(&endpoint);
 }
 
-void OnNewSimulationControl(AMM::SimulationControl& simControl, eprosima::fastrtps::SampleInfo_t* info) {
-   std::string message;
+// Threading: DDS listener threads only look up the signal and push a
+// compact event into the ingest ring of their topic. The I/O thread runs
+// ioc and does everything else: it applies the events, serializes and
+// writes to ROS, and handles messages from ROS.
 
-   switch (simControl.type()) {
+void onSimulationControl(int type) {
+   switch ((AMM::ControlType)type) {
       case AMM::ControlType::RUN :
          //writeRunSimPacket();
          sim_status = 1;
          LOG_INFO << "SimControl Message recieved; Run sim.";
+         writeEventPacket("run");
+         callEventServices("run");
          break;
 
       case AMM::ControlType::HALT :
          sim_status = 2;
          LOG_INFO << "SimControl Message recieved; Halt sim.";
+         writeEventPacket("halt");
+         callEventServices("halt");
          break;
 
       case AMM::ControlType::RESET :
          //TODO: clear data and send to ROS before stopping
-         nodeDataStorage.clear();
+         nodeData.reset();
          sim_status = 0;
          //writeResetSimPacket();
          LOG_INFO << "SimControl Message recieved; Reset sim.";
+         writeEventPacket("reset");
+         callEventServices("reset");
          break;
 
       case AMM::ControlType::SAVE :
@@ -163,43 +483,113 @@ void OnNewSimulationControl(AMM::SimulationControl& simControl, eprosima::fastrt
    }
 }
 
+void onTick(int64_t frame) {
+   if ( sim_status == 0 && frame > lastTick) {
+      LOG_DEBUG << "Tick received! sim_status:" << sim_status << "->1 lastTick:" << lastTick << " tick.frame(): " << frame;
+      sim_status = 1;
+      if ( rosFanout.connected() && ros_initialized ); //writeStateChangePacket(sim_status);
+   }
+   lastTick = frame;
+}
+
+// runs on the I/O thread
+void onIngestEvent(const ingest_event& event) {
+   switch (event.type) {
+      case ingest_event::phys_value :
+      case ingest_event::waveform_sample :
+         // values are forwarded to ROS by physScheduler at the configured
+         // rates, waveform samples in chunks
+         rosPublisher.on_ingest(event);
+         break;
+      case ingest_event::tick :
+         onTick(event.frame);
+         break;
+      case ingest_event::sim_control :
+         onSimulationControl(event.id);
+         break;
+   }
+}
+
+ingest_pipeline ingest(ioc, onIngestEvent);
+std::size_t physSource, waveformSource, tickSource, controlSource;
+
+// --capture: every received sample, before filtering. --replay: samples
+// from a capture are injected through the DDS callbacks below.
+capture_writer capture;
+std::atomic<bool> replaying{false};
+
+int64_t steadyNow() {
+   return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// time spent in the DDS callbacks, per topic. Long callbacks hold up the
+// listener threads and with them the DDS readers.
+enum dds_topic {
+   dds_simulation_control,
+   dds_tick,
+   dds_physiology_value,
+   dds_physiology_waveform,
+   dds_render_modification,
+   dds_physiology_modification,
+   dds_topics
+};
+const char* ddsTopicNames[dds_topics] = {
+   "SimulationControl", "Tick", "PhysiologyValue", "PhysiologyWaveform", "RenderModification", "PhysiologyModification"
+};
+bridge_metrics::counter_id ddsCallbacks[dds_topics] = {};
+
+// records the duration of the callback it is declared in when it returns
+struct callback_timer {
+   dds_topic topic;
+   int64_t start;
+   ~callback_timer() { metrics.record(ddsCallbacks[topic], steadyNow() - start); }
+};
+
+// DDS source timestamp of a sample in the steady clock domain of received.
+// Only meaningful if the clocks of the AMM hosts are synchronized.
+int64_t sourceTime(const SampleInfo_t* info, int64_t received) {
+   if (!info) return 0;
+   int64_t source = info->sourceTimestamp.to_ns();
+   if (source <= 0) return 0;
+   int64_t wallNow = duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+   return received - (wallNow - source);
+}
+
+void OnNewSimulationControl(AMM::SimulationControl& simControl, eprosima::fastrtps::SampleInfo_t* info) {
+   int64_t received = steadyNow();
+   callback_timer timer{dds_simulation_control, received};
+   if ( capture.is_open() )
+      capture.write(capture_record_header::sim_control, received, 0.0, (int64_t)simControl.type());
+   ingest_event event = {ingest_event::sim_control, (int32_t)simControl.type(), 0.0, received, 0, 0};
+   ingest.push(controlSource, event);
+}
+
 void OnNewTick(AMM::Tick& tick, eprosima::fastrtps::SampleInfo_t* info) {
    //if ( arguments.verbose )
    //   LOG_DEBUG << "Tick received!";
-   if ( sim_status == 0 && tick.frame() > lastTick) {
-      LOG_DEBUG << "Tick received! sim_status:" << sim_status << "->1 lastTick:" << lastTick << " tick.frame(): " << tick.frame();
-      sim_status = 1;
-      if ( websocket_connected && ros_initialized ); //writeStateChangePacket(sim_status);
-   }
-   lastTick = tick.frame();
+   int64_t received = steadyNow();
+   callback_timer timer{dds_tick, received};
+   if ( capture.is_open() )
+      capture.write(capture_record_header::tick, received, 0.0, (int64_t)tick.frame());
+   ingest_event event = {ingest_event::tick, 0, 0.0, received, 0, (int64_t)tick.frame()};
+   ingest.push(tickSource, event);
 }
 
 void OnPhysiologyValue(AMM::PhysiologyValue& physiologyvalue, eprosima::fastrtps::SampleInfo_t* info){
-   //const std::lock_guard<std::mutex> lock(nds_mutex);
-   // store all received phys values
-   if (!std::isnan(physiologyvalue.value())) {
-      nodeDataStorage[physiologyvalue.name()] = std::to_string(physiologyvalue.value());
+   // hand received phys values of interest to the I/O thread. no formatting
+   // here, values are converted to text when they are serialized for ROS.
+   int64_t received = steadyNow();
+   callback_timer timer{dds_physiology_value, received};
+   if ( capture.is_open() )
+      capture.write(capture_record_header::phys_value, received, physiologyvalue.value(), 0,
+                    physiologyvalue.name(), physiologyvalue.unit());
+   signal_registry::signal_id id = nodeData.find(physiologyvalue.name());
+   if (id != signal_registry::invalid_id && !std::isnan(physiologyvalue.value())) {
+      nodeData.set_unit(id, physiologyvalue.unit());
+      ingest_event event = {ingest_event::phys_value, id, physiologyvalue.value(), received, sourceTime(info, received), 0};
+      ingest.push(physSource, event);
       //if ( arguments.verbose )
       //   LOG_DEBUG << "[AMM_Node_Data] " << physiologyvalue.name() << " = " << physiologyvalue.value();
-      // phys values are updated every 200ms (5Hz)
-      // check when new SIM_TIME is received and reduce to updates only once per second
-      // forward data to ROS
-      if (physiologyvalue.name()=="SIM_TIME") {
-         static float sim_time_last = 0.0;
-         float sim_time = 0.0;
-         // reformat SIM_TIME for storage
-         std::ostringstream oss;
-         oss.precision(1);
-         oss << std::fixed << physiologyvalue.value();
-         nodeDataStorage["SIM_TIME"] = oss.str();
-         sim_time = std::stof(nodeDataStorage["SIM_TIME"]);
-         //LOG_DEBUG << "sim time stringstream: " << oss.str();
-         // send data if websocket connection to ros is live
-         if ( websocket_connected && (sim_time-sim_time_last > 1.0) ) {
-            writePhysDataPacket();
-            sim_time_last = sim_time;
-         }
-      }
    }
 
    static bool printRRdata = true;  // set flag to print only initial value received
@@ -212,15 +602,31 @@ void OnPhysiologyValue(AMM::PhysiologyValue& physiologyvalue, eprosima::fastrtps
 }
 
 void OnPhysiologyWaveform(AMM::PhysiologyWaveform &waveform, SampleInfo_t *info) {
+   int64_t received = steadyNow();
+   callback_timer timer{dds_physiology_waveform, received};
+   if ( capture.is_open() )
+      capture.write(capture_record_header::waveform_sample, received, waveform.value(), 0,
+                    waveform.name(), waveform.unit());
+
    // testing mohses data connection
    static int printHFdata = 10;   // initialize counter to print first xx high freequency data points
    if ( arguments.verbose && printHFdata > 0) {
       LOG_DEBUG << "[AMM_Node_Data](HF) " << waveform.name() << "=" << waveform.value();
       printHFdata -= 1;
    }
+
+   std::size_t index = rosPublisher.waveform(waveform.name());
+   if (index == ros_publisher::npos || std::isnan(waveform.value())) return;
+   rosPublisher.set_waveform_unit(index, waveform.unit());
+   ingest_event event = {ingest_event::waveform_sample, (int32_t)index, waveform.value(), received, sourceTime(info, received), 0};
+   ingest.push(waveformSource, event);
 }
 
 void OnNewRenderModification(AMM::RenderModification &rendMod, SampleInfo_t *info) {
+   int64_t received = steadyNow();
+   callback_timer timer{dds_render_modification, received};
+   if ( capture.is_open() )
+      capture.write(capture_record_header::render_mod, received, 0.0, 0, rendMod.type(), rendMod.data());
    // LOG_DEBUG << "Render Modification received:\n"
    //          << "Type:      " << rendMod.type() << "\n"
    //          << "Data:      " << rendMod.data();
@@ -237,41 +643,105 @@ void OnNewRenderModification(AMM::RenderModification &rendMod, SampleInfo_t *inf
 
 // Sample physmod payload for physmod type "airwayobstruction"
 // <?xml version="1.0" encoding="UTF-8"?><PhysiologyModification type="AirwayObstruction"><Severity>0.5</Severity></PhysiologyModification>
+// Modifications are rare but come in bursts at scenario state transitions.
+// They carry text, which does not fit an ingest event, so the listener
+// thread posts type and data to the I/O thread, where they are translated
+// and written to ROS like everything else.
+void onPhysiologyModification(const std::string& type, const std::string& data, int64_t received) {
+   std::shared_ptr<outbound_message> message = rosFanout.acquire();
+   physmod_translator::type_id id = physmodTranslator.translate(type, data, message->data);
+   if (id == physmod_translator::invalid_id) {
+      if ( arguments.verbose )
+         LOG_DEBUG << "Physiology Modification not forwarded:\n"
+                   << "Type:      " << type << "\n"
+                   << "Data:      " << data;
+      return;
+   }
+   if ( arguments.verbose )
+      LOG_DEBUG << "Physiology Modification " << physmodTranslator.type(id) << " forwarded to " << physmodTranslator.topic(id);
+
+   message_trace trace;
+   trace.topic = physmodTraceTopics[id];
+   trace.received = received;
+   writeMessage(std::move(message), -1, nullptr, trace);
+}
+
 void OnNewPhysiologyModification(AMM::PhysiologyModification &physMod, SampleInfo_t *info) {
-   // LOG_DEBUG << "Physiology Modification received:\n"
-   //          << "Type:      " << physMod.type() << "\n"
-   //          << "Data:      " << physMod.data();
-   tinyxml2::XMLDocument doc;
-   doc.Parse(physMod.data().c_str());
-
-   if (doc.ErrorID() == 0) {
-      tinyxml2::XMLElement* pRoot;
-
-      pRoot = doc.FirstChildElement("PhysiologyModification");
-
-      while (pRoot) {
-         std::string pmType = pRoot->ToElement()->Attribute("type");
-         boost::algorithm::to_lower(pmType);
-         //LOG_INFO << "Physmod type " << pmType;
-
-         if (pmType == "airwayobstruction") {
-            // Type:      PhysiologyModification
-            // Data:      <?xml version="1.0" encoding="UTF-8"?><PhysiologyModification type="AirwayObstruction"><Severity>0.5</Severity></PhysiologyModification>
-            double pmSev = std::stod(pRoot->FirstChildElement("Severity")->ToElement()->GetText());
-            LOG_INFO << "Physiology Modification received: AirwayObstruction. Severity:" << pmSev;
-            // forward physmod to ROS or translate to some other action
-            return;
-         } else {
-            LOG_DEBUG << "Physiology Modification received:\n"
-                     << "Type:      " << pmType << "\n"
-                     << "Data:      " << physMod.data();
-            return;
-         }
+   int64_t received = steadyNow();
+   callback_timer timer{dds_physiology_modification, received};
+   if ( capture.is_open() )
+      capture.write(capture_record_header::physiology_mod, received, 0.0, 0, physMod.type(), physMod.data());
+
+   net::post(ioc, [type = physMod.type(), data = physMod.data(), received]() {
+      onPhysiologyModification(type, data, received);
+   });
+}
+
+// inject the samples of a capture file through the DDS callbacks, with the
+// recorded spacing divided by speed, or as fast as possible if speed is 0
+void replayCapture(const std::string& path, double speed) {
+   capture_reader reader;
+   if (!reader.open(path)) return;
+
+   // start once ROS is there, samples are not forwarded before that
+   while ( replaying && !rosFanout.connected() )
+      std::this_thread::sleep_for(milliseconds(10));
+
+   AMM::PhysiologyValue value;
+   AMM::PhysiologyWaveform waveform;
+   AMM::Tick tick;
+   AMM::SimulationControl simControl;
+   AMM::PhysiologyModification physMod;
+   AMM::RenderModification rendMod;
+   std::string name, text;
+
+   LOG_INFO << "Replaying " << path << (speed > 0 ? "" : " as fast as possible");
+   uint64_t count = 0;
+   auto start = steady_clock::now();
+   capture_record record;
+   while ( replaying && reader.next(record) ) {
+      if (speed > 0) {
+         auto due = start + duration_cast<steady_clock::duration>(nanoseconds((int64_t)(record.timestamp / speed)));
+         if (due > steady_clock::now()) std::this_thread::sleep_until(due);
       }
-   } else {
-      //LOG_ERROR << "Document parsing error, ID: " << doc.ErrorID();
-      //doc.PrintError();
+      name.assign(record.name, record.name_length);
+      text.assign(record.text, record.text_length);
+      switch (record.type) {
+         case capture_record_header::phys_value :
+            value.name(name);
+            value.unit(text);
+            value.value(record.value);
+            OnPhysiologyValue(value, nullptr);
+            break;
+         case capture_record_header::waveform_sample :
+            waveform.name(name);
+            waveform.unit(text);
+            waveform.value(record.value);
+            OnPhysiologyWaveform(waveform, nullptr);
+            break;
+         case capture_record_header::tick :
+            tick.frame(record.frame);
+            OnNewTick(tick, nullptr);
+            break;
+         case capture_record_header::sim_control :
+            simControl.type((AMM::ControlType)record.frame);
+            OnNewSimulationControl(simControl, nullptr);
+            break;
+         case capture_record_header::physiology_mod :
+            physMod.type(name);
+            physMod.data(text);
+            OnNewPhysiologyModification(physMod, nullptr);
+            break;
+         case capture_record_header::render_mod :
+            rendMod.type(name);
+            rendMod.data(text);
+            OnNewRenderModification(rendMod, nullptr);
+            break;
+      }
+      ++count;
    }
+   double elapsed = duration<double>(steady_clock::now() - start).count();
+   LOG_INFO << "Replayed " << count << " samples in " << elapsed << " s (" << (elapsed > 0 ? count / elapsed : 0) << "/s)";
 }
 
 void PublishOperationalDescription() {
@@ -283,8 +753,7 @@ void PublishOperationalDescription() {
     od.module_id(m_uuid);
     od.module_version("0.1.0");
     od.description("A bridge module to connect MoHSES to a ROS instance.");
-    const std::string capabilities = AMM::Utility::read_file_to_string("config/ros_bridge_capabilities.xml");
-    od.capabilities_schema(capabilities);
+    od.capabilities_schema(capabilitiesXml);
     od.description();
     mgr->WriteOperationalDescription(od);
 }
@@ -295,19 +764,228 @@ void PublishConfiguration() {
     mc.timestamp(ms);
     mc.module_id(m_uuid);
     mc.name(moduleName);
-    const std::string configuration = AMM::Utility::read_file_to_string("config/ros_bridge_configuration.xml");
-    mc.capabilities_configuration(configuration);
+    mc.capabilities_configuration(configurationXml);
     mgr->WriteModuleConfiguration(mc);
 }
 
+// register the metrics. Counters are added to from here on, values counted
+// elsewhere are read on the I/O thread when the metrics are served.
+void registerMetrics() {
+   for (std::size_t t = 0; t < tracer.topics(); ++t) {
+      std::string topic = bridge_metrics::label("topic", tracer.topic_name((int)t));
+      traffic_counters out;
+      out.messages = metrics.counter("ros_bridge_topic_messages_out_total", "Messages queued for ROS per topic", topic);
+      out.bytes = metrics.counter("ros_bridge_topic_bytes_out_total", "Bytes queued for ROS per topic", topic);
+      topicsOut.push_back(out);
+   }
+   opsOut.messages = metrics.counter("ros_bridge_ops_out_total", "Other rosbridge ops queued for ROS: advertise, subscribe, events");
+   opsOut.bytes = metrics.counter("ros_bridge_ops_bytes_out_total", "Bytes of other rosbridge ops queued for ROS");
+   for (std::size_t r = 0; r < rosRouter.size(); ++r) {
+      std::string topic = bridge_metrics::label("topic", rosRouter.topic((int)r));
+      traffic_counters in;
+      in.messages = metrics.counter("ros_bridge_topic_messages_in_total", "Messages received from ROS per subscribed topic", topic);
+      in.bytes = metrics.counter("ros_bridge_topic_bytes_in_total", "Bytes received from ROS per subscribed topic", topic);
+      topicsIn.push_back(in);
+   }
+   parseErrors = metrics.counter("ros_bridge_parse_errors_total", "Messages from ROS that could not be parsed");
+
+   for (std::size_t i = 0; i < rosFanout.endpoints().size(); ++i) {
+      const ros_endpoint* endpoint = rosFanout.endpoints()[i].get();
+      const fragment_assembler* fragments = fragmentAssemblers[i].get();
+      std::string name = bridge_metrics::label("endpoint", endpoint->host() + ":" + endpoint->port());
+      traffic_counters in;
+      in.messages = metrics.counter("ros_bridge_endpoint_messages_in_total", "Websocket messages received", name);
+      in.bytes = metrics.counter("ros_bridge_endpoint_bytes_in_total", "Websocket message bytes received", name);
+      endpointsIn.push_back(in);
+      metrics.counter("ros_bridge_endpoint_messages_written_total", "Websocket messages written, fragments counted each", name,
+                      [endpoint]() { return (double)endpoint->stats().written; });
+      metrics.counter("ros_bridge_endpoint_bytes_written_total", "Websocket message bytes written", name,
+                      [endpoint]() { return (double)endpoint->stats().written_bytes; });
+      metrics.gauge("ros_bridge_endpoint_connected", "1 while the websocket session is open", name,
+                    [endpoint]() { return endpoint->connected() ? 1.0 : 0.0; });
+      metrics.counter("ros_bridge_endpoint_reconnects_total", "Connections lost or refused and attempted again", name,
+                      [endpoint]() { return (double)endpoint->reconnects(); });
+      metrics.gauge("ros_bridge_queue_depth", "Messages in the outbound queue", name,
+                    [endpoint]() { return (double)endpoint->stats().depth; });
+      metrics.gauge("ros_bridge_queue_capacity", "Size of the outbound queue", name,
+                    [endpoint]() { return (double)endpoint->stats().capacity; });
+      metrics.counter("ros_bridge_queue_coalesced_total", "Queued messages replaced by a newer one of the same key", name,
+                      [endpoint]() { return (double)endpoint->stats().coalesced; });
+      metrics.counter("ros_bridge_queue_dropped_total", "Messages dropped by a full outbound queue",
+                      name + "," + bridge_metrics::label("policy", "oldest"),
+                      [endpoint]() { return (double)endpoint->stats().dropped_oldest; });
+      metrics.counter("ros_bridge_queue_dropped_total", "Messages dropped by a full outbound queue",
+                      name + "," + bridge_metrics::label("policy", "newest"),
+                      [endpoint]() { return (double)endpoint->stats().dropped_newest; });
+      metrics.counter("ros_bridge_fragmented_out_total", "Messages sent as rosbridge fragments", name,
+                      [endpoint]() { return (double)endpoint->stats().fragmented; });
+      metrics.counter("ros_bridge_fragmented_in_total", "Fragmented messages from ROS joined", name,
+                      [fragments]() { return (double)fragments->completed(); });
+      metrics.counter("ros_bridge_fragmented_in_dropped_total", "Fragmented messages from ROS dropped incomplete", name,
+                      [fragments]() { return (double)fragments->dropped(); });
+   }
+
+   for (int t = 0; t < dds_topics; ++t)
+      ddsCallbacks[t] = metrics.duration("ros_bridge_dds_callback_seconds", "Time spent in the DDS listener callbacks",
+                                         bridge_metrics::label("topic", ddsTopicNames[t]));
+   metrics.counter("ros_bridge_ingest_dropped_total", "AMM samples dropped, ingest rings full", "",
+                   []() { return (double)ingest.dropped(); });
+   metrics.counter("ros_bridge_pool_reused_total", "Outbound messages taken from the pool", "",
+                   []() { return (double)rosFanout.pool().hits(); });
+   metrics.counter("ros_bridge_pool_allocated_total", "Outbound messages allocated when the pool was empty", "",
+                   []() { return (double)rosFanout.pool().misses(); });
+   metrics.counter("ros_bridge_service_calls_total", "ROS service calls completed", bridge_metrics::label("status", "succeeded"),
+                   []() { return (double)serviceCaller.succeeded(); });
+   metrics.counter("ros_bridge_service_calls_total", "ROS service calls completed", bridge_metrics::label("status", "failed"),
+                   []() { return (double)serviceCaller.failed(); });
+   metrics.counter("ros_bridge_service_calls_total", "ROS service calls completed", bridge_metrics::label("status", "timed_out"),
+                   []() { return (double)serviceCaller.timed_out(); });
+   metrics.gauge("ros_bridge_service_calls_in_flight", "ROS service calls waiting for their response", "",
+                 []() { return (double)serviceCaller.in_flight(); });
+   metrics.gauge("ros_bridge_service_calls_waiting", "ROS service calls waiting to be sent", "",
+                 []() { return (double)serviceCaller.waiting(); });
+}
+
+// counter totals at the last status summary, for rates
+struct status_totals {
+   uint64_t messagesOut = 0;
+   uint64_t bytesOut = 0;
+   uint64_t messagesIn = 0;
+   uint64_t dropped = 0;
+   steady_clock::time_point at;
+};
+status_totals lastStatus;
+
+status_totals statusTotals() {
+   status_totals totals;
+   totals.at = steady_clock::now();
+   for (const traffic_counters& out : topicsOut) {
+      totals.messagesOut += metrics.value(out.messages);
+      totals.bytesOut += metrics.value(out.bytes);
+   }
+   totals.messagesOut += metrics.value(opsOut.messages);
+   totals.bytesOut += metrics.value(opsOut.bytes);
+   for (const traffic_counters& in : endpointsIn)
+      totals.messagesIn += metrics.value(in.messages);
+   for (const auto& endpoint : rosFanout.endpoints()) {
+      queue_stats stats = endpoint->stats();
+      totals.dropped += stats.dropped_oldest + stats.dropped_newest;
+   }
+   totals.dropped += ingest.dropped();
+   return totals;
+}
+
+// publish a one line summary of the counters since the last one on the
+// AMM Status topic, e.g. "to ROS 120.0 msg/s 18.4 kB/s, from ROS 2.0 msg/s,
+// queued 3, dropped 0, reconnects 0, parse errors 0"
+void publishStatus() {
+   status_totals totals = statusTotals();
+   double seconds = std::max(duration<double>(totals.at - lastStatus.at).count(), 1e-3);
+   std::size_t queued = 0, reconnects = 0;
+   for (const auto& endpoint : rosFanout.endpoints()) {
+      queued += endpoint->stats().depth;
+      reconnects += endpoint->reconnects();
+   }
+
+   std::ostringstream summary;
+   summary << std::fixed << std::setprecision(1)
+           << "to ROS " << (totals.messagesOut - lastStatus.messagesOut) / seconds << " msg/s "
+           << (totals.bytesOut - lastStatus.bytesOut) / seconds / 1000.0 << " kB/s, "
+           << "from ROS " << (totals.messagesIn - lastStatus.messagesIn) / seconds << " msg/s, "
+           << "queued " << queued << ", dropped " << totals.dropped - lastStatus.dropped
+           << ", reconnects " << reconnects << ", parse errors " << metrics.value(parseErrors);
+   lastStatus = totals;
+
+   AMM::Status status;
+   status.module_id(m_uuid);
+   status.module_name(moduleName);
+   status.value(rosFanout.connected() ? AMM::StatusValue::OPERATIONAL : AMM::StatusValue::INOPERATIVE);
+   status.message(summary.str());
+   mgr->WriteStatus(status);
+}
+
+void scheduleStatus() {
+   statusTimer.expires_after(seconds(arguments.status_interval));
+   statusTimer.async_wait([](const error_code& ec) {
+      if (ec) return;
+      publishStatus();
+      scheduleStatus();
+   });
+}
+
+// runs on the I/O thread once the AMM entities exist
+void onAmmReady() {
+   ammReady = true;
+   for (const auto& endpoint : rosFanout.endpoints())
+      if (endpoint->connected()) writeSubscribePackets(*endpoint);
+
+   // announce the module again for readers still being matched by
+   // discovery, instead of holding up startup until they are
+   announceTimer.expires_after(milliseconds(250));
+   announceTimer.async_wait([](const error_code& ec) {
+      if (ec) return;
+      PublishOperationalDescription();
+      PublishConfiguration();
+   });
+
+   if ( arguments.status_interval > 0 ) {
+      lastStatus = statusTotals();
+      scheduleStatus();
+   }
+}
+
+// pin the calling thread to one cpu
+void pinThread(int cpu) {
+   cpu_set_t cpus;
+   CPU_ZERO(&cpus);
+   CPU_SET(cpu, &cpus);
+   int rc = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+   if (rc != 0)
+      LOG_WARNING << "Could not pin thread to cpu " << cpu << ": " << strerror(rc);
+   else
+      LOG_INFO << "I/O thread pinned to cpu " << cpu;
+}
+
+// kill -USR1 <pid> logs the latency histograms, the flight recorder, the
+// outbound pool, service call and fragment counters
+void onTraceSignal(const error_code& ec, int signal) {
+   if (ec) return;
+   tracer.log_summary();
+   tracer.dump_recorder();
+   const message_pool& pool = rosFanout.pool();
+   LOG_INFO << "Outbound pool: " << pool.size() << " messages, " << pool.hits() << " reused, "
+            << pool.misses() << " allocated when the pool was empty";
+   LOG_INFO << "ROS service calls: " << serviceCaller.succeeded() << " succeeded, " << serviceCaller.failed() << " failed, "
+            << serviceCaller.timed_out() << " timed out, " << serviceCaller.in_flight() << " in flight, "
+            << serviceCaller.waiting() << " waiting";
+   for (std::size_t i = 0; i < fragmentAssemblers.size(); ++i) {
+      const ros_endpoint& endpoint = *rosFanout.endpoints()[i];
+      LOG_INFO << "Fragments " << endpoint.host() << ":" << endpoint.port() << ": "
+               << endpoint.stats().fragmented << " messages sent fragmented, "
+               << fragmentAssemblers[i]->completed() << " joined, " << fragmentAssemblers[i]->dropped() << " dropped, "
+               << fragmentAssemblers[i]->buffered() << " bytes buffered";
+   }
+   traceSignals.async_wait(onTraceSignal);
+}
+
 void checkForExit() {
    // wait for key press
    std::cin.get();
    std::cout << "Key pressed ... Shutting down." << std::endl;
 
-   // stop() will cause run() to return and leave the reconnect loop
-   try_reconnect = false;
-   ioc.stop();
+   // close all sessions and let run() return once they are done
+   replaying = false;
+   net::post(ioc, []() {
+      traceSignals.cancel();
+      announceTimer.cancel();
+      statusTimer.cancel();
+      if ( metricsServer ) metricsServer->stop();
+      physScheduler.stop();
+      serviceCaller.cancel_all();
+      writeShutdownPackets();
+      rosFanout.stop();
+      iocWork.reset();
+   });
 
    // Raise SIGTERM to trigger async signal handler
    //std::raise(SIGTERM);
@@ -316,18 +994,212 @@ void checkForExit() {
 int main(int argc, char *argv[]) {
 
    // set default command line options. process.
-   arguments.hostname = (char *)"10.0.0.195";
+   arguments.hostname = NULL;   // from the configuration, 10.0.0.195 if none
    arguments.port = (char *)"9090";
    arguments.autostart = false;
    arguments.verbose = false;
+   arguments.batch = false;
+   arguments.signals = NULL;
+   arguments.queue_depth = 1024;
+   arguments.queue_policy = (char *)"oldest";
+   arguments.waveforms = NULL;
+   arguments.waveform_window = 0;
+   arguments.encoding = (char *)"json";
+   arguments.deflate = false;
+   arguments.deflate_window = 15;
+   arguments.deflate_level = 8;
+   arguments.deflate_threshold = 0;
+   arguments.fragment_size = 0;
+   arguments.transport = NULL;   // from the configuration, websocket if none
+   arguments.nagle = false;
+   arguments.send_buffer = 0;
+   arguments.receive_buffer = 0;
+   arguments.keep_alive = 0;
+   arguments.reconnect_min = 25;
+   arguments.reconnect_max = 5000;
+   arguments.io_cpu = -1;
+   arguments.service_limit = 16;
+   arguments.metrics_port = 0;
+   arguments.metrics_address = (char *)"127.0.0.1";
+   arguments.status_interval = 10;
+   arguments.capture = NULL;
+   arguments.replay = NULL;
+   arguments.replay_speed = 1.0;
    argp_parse(&argp, argc, argv, 0, 0, &arguments);
 
    static plog::ColorConsoleAppender<plog::TxtFormatter> consoleAppender;
    plog::init(plog::verbose, &consoleAppender);
 
    LOG_INFO << "=== [ ROS Bridge ] ===";
-   LOG_INFO << "Host IP number = " << arguments.hostname;
-   LOG_INFO << "Host port = " << arguments.port;
+   startupBegin = steady_clock::now();
+   steady_clock::time_point phase = startupBegin;
+   // AMM to ROS mapping. defaults are used if the configuration has no
+   // <ROS> section, the command line overrides the configuration.
+   publish_mapping physDefault;
+   physDefault.topic = "/hr/physiology";
+   physDefault.field = "physiologyvalue";
+   physDefault.signals = {
+      {"Cardiovascular_HeartRate"},
+      {"CerebralBloodFlow"},
+      {"IntracranialPressure"},
+      {"CerebralPerfusionPressure"},
+   };
+   bridgeConfig.publish.push_back(physDefault);
+   bridgeConfig.events.push_back({"connect", "/hr/control/speech/say", "", {{"text", "MoHSES connected via ros-bridge"}}});
+   bridgeConfig.modifications.push_back({"AirwayObstruction", "/hr/amm/airway_obstruction", "", {{"Severity", "severity", false, "0"}}});
+   configurationXml = AMM::Utility::read_file_to_string(bridgeConfigFile);
+   capabilitiesXml = AMM::Utility::read_file_to_string(capabilitiesFile);
+   bridgeConfig.parse(configurationXml);
+
+   if ( arguments.signals ) {
+      std::vector<std::string> names;
+      boost::algorithm::split(names, std::string(arguments.signals), boost::is_any_of(","), boost::token_compress_on);
+      physDefault.signals.clear();
+      for (const std::string& name : names)
+         if (!name.empty()) physDefault.signals.push_back({name});
+      bridgeConfig.publish.assign(1, physDefault);
+   }
+   if ( arguments.batch ) {
+      for (publish_mapping& mapping : bridgeConfig.publish) {
+         if (mapping.batch) continue;
+         mapping.batch = true;
+         if (mapping.field == "physiologyvalue") mapping.field = "physiologyvalues";
+      }
+   }
+   if ( arguments.waveforms ) {
+      bridgeConfig.waveforms.names.clear();
+      boost::algorithm::split(bridgeConfig.waveforms.names, std::string(arguments.waveforms), boost::is_any_of(","), boost::token_compress_on);
+   }
+   if ( arguments.waveform_window > 0 )
+      bridgeConfig.waveforms.window = arguments.waveform_window;
+
+   // ROS instances: -h HOST[:PORT],... replaces the configured endpoints
+   if ( arguments.hostname ) {
+      std::vector<std::string> hosts;
+      boost::algorithm::split(hosts, std::string(arguments.hostname), boost::is_any_of(","), boost::token_compress_on);
+      bridgeConfig.endpoints.clear();
+      for (const std::string& host : hosts) {
+         if (host.empty()) continue;
+         std::size_t colon = host.rfind(':');
+         if (colon == std::string::npos)
+            bridgeConfig.endpoints.push_back({host, arguments.port});
+         else
+            bridgeConfig.endpoints.push_back({host.substr(0, colon), host.substr(colon + 1)});
+      }
+   }
+   if ( bridgeConfig.endpoints.empty() )
+      bridgeConfig.endpoints.push_back({"10.0.0.195", arguments.port});
+
+   // --transport replaces the configured transports. rosbridge_tcp has no
+   // framing for binary messages, cbor is only used if no endpoint is tcp.
+   bool tcpTransport = false;
+   for (endpoint_mapping& mapping : bridgeConfig.endpoints) {
+      if ( arguments.transport ) mapping.transport = arguments.transport;
+      if (mapping.transport == "tcp") tcpTransport = true;
+      else if (!mapping.transport.empty() && mapping.transport != "websocket")
+         LOG_WARNING << "Unknown transport " << mapping.transport << " for " << mapping.host << ", using websocket";
+   }
+   useCbor = strcmp(arguments.encoding, "cbor") == 0;
+   if ( useCbor && tcpTransport ) {
+      LOG_WARNING << "cbor encoding is not supported by the tcp transport, using json";
+      useCbor = false;
+   }
+
+   // sessions, their outbound queues, message encoding, compression and sockets
+   endpoint_options options;
+   options.queue_size = arguments.queue_depth;
+   if (strcmp(arguments.queue_policy, "newest") == 0)
+      options.policy = queue_policy::drop_newest;
+   else if (strcmp(arguments.queue_policy, "block") == 0)
+      options.policy = queue_policy::block;
+   else
+      options.policy = queue_policy::drop_oldest;
+   options.binary = useCbor;
+   options.deflate = arguments.deflate;
+   options.deflate_window = arguments.deflate_window;
+   options.deflate_level = arguments.deflate_level;
+   options.deflate_threshold = arguments.deflate_threshold;
+   options.fragment_size = arguments.fragment_size;
+   options.reconnect_min = milliseconds(arguments.reconnect_min);
+   options.reconnect_max = milliseconds(std::max(arguments.reconnect_max, arguments.reconnect_min));
+   options.socket.no_delay = !arguments.nagle;
+   options.socket.send_buffer = arguments.send_buffer;
+   options.socket.receive_buffer = arguments.receive_buffer;
+   options.socket.keep_alive = arguments.keep_alive;
+   options.tracer = &tracer;
+   options.verbose = arguments.verbose;
+
+   for (const endpoint_mapping& mapping : bridgeConfig.endpoints) {
+      endpoint_options endpointOptions = options;
+      endpointOptions.transport = mapping.transport == "tcp" ? transport_type::tcp : transport_type::websocket;
+      auto endpoint = std::make_shared<ros_endpoint>(ioc, mapping.host, mapping.port, target, endpointOptions);
+      endpoint->on_handshake(onWebsocketHandshake);
+      auto fragments = std::make_shared<fragment_assembler>([](char* data, std::size_t size) {
+         onNewWebsocketMessage(net::mutable_buffer(data, size), false, nullptr);
+      }, fragment_limits());
+      fragmentAssemblers.push_back(fragments);
+      std::size_t index = fragmentAssemblers.size() - 1;
+      endpoint->on_read([fragments, index](net::mutable_buffer msg, bool binary) {
+         countTraffic(endpointsIn[index], msg.size());
+         onNewWebsocketMessage(msg, binary, fragments.get());
+      });
+      rosFanout.add(endpoint);
+      LOG_INFO << "ROS instance " << mapping.host << ":" << mapping.port
+               << (endpointOptions.transport == transport_type::tcp ? " (tcp)" : "");
+   }
+   LOG_INFO << "Outbound queue: " << rosFanout.endpoints().front()->stats().capacity << " messages per instance, policy " << arguments.queue_policy;
+   LOG_INFO << "Encoding: " << (useCbor ? "cbor" : "json") << (arguments.deflate ? ", permessage-deflate" : "");
+   LOG_INFO << "Sockets: " << (arguments.nagle ? "Nagle" : "TCP_NODELAY")
+            << (arguments.keep_alive > 0 ? ", keepalive after " + std::to_string(arguments.keep_alive) + " s" : "");
+   if ( arguments.fragment_size > 0 )
+      LOG_INFO << "Sending messages over " << arguments.fragment_size << " bytes as rosbridge fragments"
+               << (useCbor ? " (json only, not with cbor)" : "");
+
+   // intern signal names and compile messages before the subscribers are created
+   for (const std::string& name : nodeDataSignals)
+      nodeData.intern(name);
+   compileMessageTemplates(useCbor ? message_template::encoding::cbor : message_template::encoding::json);
+   serviceCaller.set_encoding(useCbor ? message_template::encoding::cbor : message_template::encoding::json);
+   serviceCaller.set_limit(arguments.service_limit);
+
+   LOG_INFO << "Forwarding " << rosPublisher.signals() << " phys values to " << rosPublisher.topics() << " topics";
+   LOG_INFO << "Forwarding " << rosPublisher.waveforms() << " waveforms in " << bridgeConfig.waveforms.window << " ms chunks";
+   LOG_INFO << "Subscribing to " << subscribeMessages.size() << " ROS topics";
+   LOG_INFO << "Advertising " << advertisements.size() << " ROS topics";
+   LOG_INFO << "Calling " << bridgeConfig.services.size() << " ROS services on events, "
+            << (arguments.service_limit > 0 ? std::to_string(arguments.service_limit) + " at once" : "without limit");
+   LOG_INFO << "Forwarding " << physmodTranslator.size() << " physiology modification types";
+   rosPublisher.on_write(onMessageWritten);
+   rosPublisher.schedule(physScheduler);
+   LOG_INFO << "Publishing on " << physScheduler.size() << " timers";
+
+   // one ingest ring per DDS topic, written by that topic's listener thread
+   physSource = ingest.add_source(4096);
+   waveformSource = ingest.add_source(16384);
+   tickSource = ingest.add_source(256);
+   controlSource = ingest.add_source(64);
+   registerSubscriptionHandlers();
+   registerMetrics();
+   logStartupPhase("configuration and message templates", phase);
+
+   // connect to all ROS instances now, the handshakes run while the DDS
+   // entities are created. Each endpoint reconnects on its own, run()
+   // returns once checkForExit() has closed them.
+   rosFanout.start();
+   physScheduler.start();
+   traceSignals.async_wait(onTraceSignal);
+   if ( arguments.metrics_port > 0 ) {
+      metricsServer = std::make_shared<metrics_server>(ioc, [](std::string& out) { metrics.render(out); });
+      if ( metricsServer->start(arguments.metrics_address, (unsigned short)arguments.metrics_port) )
+         LOG_INFO << "Metrics on http://" << arguments.metrics_address << ":" << arguments.metrics_port << "/metrics";
+   }
+   std::thread ioThread([]() {
+      if ( arguments.io_cpu >= 0 ) pinThread(arguments.io_cpu);
+      ioc.run();
+   });
+
+   mgr = new AMM::DDSManager<void>(configFile);
+   logStartupPhase("DDS participant", phase);
 
    mgr->InitializeOperationalDescription();
    mgr->CreateOperationalDescriptionPublisher();
@@ -335,66 +1207,68 @@ int main(int argc, char *argv[]) {
    mgr->InitializeModuleConfiguration();
    mgr->CreateModuleConfigurationPublisher();
 
+   if ( arguments.capture && capture.open(arguments.capture) )
+      LOG_INFO << "Capturing AMM samples to " << arguments.capture;
+
+   // a replay replaces the AMM subscriptions, so runs are repeatable
+   bool subscribe = !arguments.replay;
+
    mgr->InitializeSimulationControl();
-   mgr->CreateSimulationControlSubscriber(&OnNewSimulationControl);
+   if ( subscribe ) mgr->CreateSimulationControlSubscriber(&OnNewSimulationControl);
 
    mgr->InitializeStatus();
    mgr->CreateStatusPublisher();
 
    mgr->InitializeTick();
-   mgr->CreateTickSubscriber(&OnNewTick);
+   if ( subscribe ) mgr->CreateTickSubscriber(&OnNewTick);
 
    mgr->InitializePhysiologyValue();
-   mgr->CreatePhysiologyValueSubscriber(&OnPhysiologyValue);
+   if ( subscribe ) mgr->CreatePhysiologyValueSubscriber(&OnPhysiologyValue);
 
    mgr->InitializePhysiologyWaveform();
-   mgr->CreatePhysiologyWaveformSubscriber(&OnPhysiologyWaveform);
+   if ( subscribe ) mgr->CreatePhysiologyWaveformSubscriber(&OnPhysiologyWaveform);
 
    mgr->InitializeRenderModification();
-   mgr->CreateRenderModificationSubscriber(&OnNewRenderModification);
+   if ( subscribe ) mgr->CreateRenderModificationSubscriber(&OnNewRenderModification);
 
    mgr->InitializePhysiologyModification();
-   mgr->CreatePhysiologyModificationSubscriber(&OnNewPhysiologyModification);
+   if ( subscribe ) mgr->CreatePhysiologyModificationSubscriber(&OnNewPhysiologyModification);
 
-   m_uuid.id(mgr->GenerateUuidString());
-
-   std::this_thread::sleep_for(milliseconds(250));
+   // publishers for messages routed from ROS
+   mgr->InitializeCommand();
+   mgr->CreateCommandPublisher();
+   mgr->CreateRenderModificationPublisher();
+   logStartupPhase("DDS entities", phase);
 
+   m_uuid.id(mgr->GenerateUuidString());
    PublishOperationalDescription();
    PublishConfiguration();
+   net::post(ioc, onAmmReady);
 
    // set up thread to check console for "exit" command
    std::thread ec(checkForExit);
    ec.detach();
 
-   //TODO: turn discovery into asynch process see mycroft bridge
-   // block until ROS instance has been discovered on the local network
-
+   logStartupPhase("module announced", phase);
    LOG_INFO << "ROS Bridge ready.";
    std::cout << "Listening for data... Press return to exit." << std::endl;
 
-   while (try_reconnect) {
-      // set up websocket session
-      ws_session->run(arguments.hostname, arguments.port, target);
-      ws_session->set_verbose( arguments.verbose );
-      ws_session->registerHandshakeCallback(onWebsocketHandshake);
-      ws_session->registerReadCallback(onNewWebsocketMessage);
-
-      LOG_INFO << "Connecting to ROS instance.";
-      // Run the I/O context.
-      // The call will return if connection fails or when the socket is closed.
-      ioc.run();
-
-      LOG_INFO << "Connection to ROS instance closed.";
-      websocket_connected = false;
-      ros_initialized = false;
-      ioc.reset();
-      // wait a while before trying to reconnect
-      // TODO skip delay on shutdown
-      std::this_thread::sleep_for(seconds(5));
+   std::thread replayThread;
+   if ( arguments.replay ) {
+      replaying = true;
+      replayThread = std::thread(replayCapture, std::string(arguments.replay), arguments.replay_speed);
    }
+   ioThread.join();
+   if ( replayThread.joinable() ) replayThread.join();
+   if ( ingest.dropped() )
+      LOG_WARNING << "Dropped " << ingest.dropped() << " AMM samples, ingest rings full";
+   tracer.log_summary();
 
    mgr->Shutdown();
+   if ( capture.is_open() ) {
+      capture.close();
+      LOG_INFO << "Captured " << capture.records() << " AMM samples to " << arguments.capture;
+   }
    std::this_thread::sleep_for(milliseconds(100));
    delete mgr;
 
@@ -0,0 +1,412 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+//
+// Loopback benchmark. Feeds synthetic physiology values, waveforms and simulation control
+// events through the bridge components (ingest rings, signal registry,
+// message templates, publish scheduler, fan-out and websocket sessions)
+// into a local rosbridge stand-in server, and reports throughput,
+// allocations and latency percentiles. Needs no DDS domain and no network.
+
+#include <argp.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "amm/BaseLogger.h"
+
+#include "websocket_session.hpp"
+#include "ros_endpoint.hpp"
+#include "ros_publisher.hpp"
+#include "message_router.hpp"
+#include "signal_registry.hpp"
+#include "publish_scheduler.hpp"
+#include "ingest_pipeline.hpp"
+#include "latency_tracer.hpp"
+
+using namespace std::chrono;
+
+// count every heap allocation of the process
+static std::atomic<std::size_t> allocations{0};
+
+void* operator new(std::size_t size) {
+   allocations.fetch_add(1, std::memory_order_relaxed);
+   if (void* p = std::malloc(size ? size : 1)) return p;
+   throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+// command line
+struct bench_arguments {
+   int signals = 10;          // synthetic phys values
+   double phys_hz = 50;       // updates per signal and second
+   double rate = 10;          // publishes per signal and second
+   int waveforms = 2;
+   double waveform_hz = 500;  // samples per waveform and second
+   int window = 50;           // waveform chunk length in ms
+   int endpoints = 1;
+   int duration = 10;         // seconds
+   int queue_depth = 1024;
+   bool cbor = false;
+   bool deflate = false;
+   bool verbose = false;
+} args;
+
+enum {
+   OPT_PHYS_HZ = 1000,
+   OPT_RATE,
+   OPT_WAVEFORM_HZ,
+   OPT_WINDOW,
+   OPT_ENDPOINTS,
+   OPT_QUEUE_DEPTH,
+   OPT_ENCODING,
+   OPT_DEFLATE,
+};
+
+static struct argp_option options[] = {
+    { "signals", 's', "N", 0, "Number of phys values (default 10)"},
+    { "phys-hz", OPT_PHYS_HZ, "HZ", 0, "Updates per phys value and second (default 50)"},
+    { "rate", OPT_RATE, "HZ", 0, "Publishes per phys value and second (default 10)"},
+    { "waveforms", 'w', "N", 0, "Number of waveforms (default 2)"},
+    { "waveform-hz", OPT_WAVEFORM_HZ, "HZ", 0, "Samples per waveform and second (default 500)"},
+    { "window", OPT_WINDOW, "MS", 0, "Waveform chunk length in ms (default 50)"},
+    { "endpoints", OPT_ENDPOINTS, "N", 0, "Number of websocket connections (default 1)"},
+    { "duration", 'd', "S", 0, "Run time in seconds (default 10)"},
+    { "queue-depth", OPT_QUEUE_DEPTH, "N", 0, "Outbound queue size (default 1024)"},
+    { "encoding", OPT_ENCODING, "ENC", 0, "json or cbor"},
+    { "deflate", OPT_DEFLATE, 0, 0, "Enable permessage-deflate"},
+    { "verbose", 'v', 0, 0, "Log bridge and server activity"},
+    { 0 }
+};
+
+static error_t parse_opt(int key, char *arg, struct argp_state *state) {
+   switch (key) {
+      case 's': args.signals = atoi(arg); break;
+      case OPT_PHYS_HZ: args.phys_hz = atof(arg); break;
+      case OPT_RATE: args.rate = atof(arg); break;
+      case 'w': args.waveforms = atoi(arg); break;
+      case OPT_WAVEFORM_HZ: args.waveform_hz = atof(arg); break;
+      case OPT_WINDOW: args.window = atoi(arg); break;
+      case OPT_ENDPOINTS: args.endpoints = atoi(arg); break;
+      case 'd': args.duration = atoi(arg); break;
+      case OPT_QUEUE_DEPTH: args.queue_depth = atoi(arg); break;
+      case OPT_ENCODING:
+         if (strcmp(arg, "json") && strcmp(arg, "cbor"))
+            argp_error(state, "invalid encoding: %s", arg);
+         args.cbor = strcmp(arg, "cbor") == 0;
+         break;
+      case OPT_DEFLATE: args.deflate = true; break;
+      case 'v': args.verbose = true; break;
+      case ARGP_KEY_ARG: argp_usage(state); break;
+      default: return ARGP_ERR_UNKNOWN;
+   }
+   if (args.signals < 0 || args.waveforms < 0 || args.endpoints < 1 || args.duration < 1 ||
+       args.phys_hz <= 0 || args.waveform_hz <= 0 || args.window <= 0 || args.queue_depth <= 0)
+      argp_error(state, "invalid value for option");
+   return 0;
+}
+
+static struct argp argp = { options, parse_opt, "",
+   "Loopback benchmark of the ROS bridge against a local rosbridge stand-in server."};
+
+/**
+ * @brief Bench_Server is a local stand-in for a rosbridge server.
+ *
+ * It accepts websocket connections on 127.0.0.1, reads the envelope of every
+ * message and counts publishes and subscribes. Runs on its own thread.
+ */
+class bench_server
+{
+public:
+   std::atomic<uint64_t> messages{0};
+   std::atomic<uint64_t> bytes{0};
+   std::atomic<uint64_t> publishes{0};
+   std::atomic<uint64_t> subscribes{0};
+   std::atomic<uint64_t> errors{0};
+
+   explicit bench_server(bool deflate)
+      : acceptor_(ioc_, tcp::endpoint(net::ip::make_address("127.0.0.1"), 0))
+      , deflate_(deflate)
+   {
+   }
+
+   unsigned short port() const { return acceptor_.local_endpoint().port(); }
+
+   void start()
+   {
+      accept();
+      thread_ = std::thread([this]() { ioc_.run(); });
+   }
+
+   void stop()
+   {
+      ioc_.stop();
+      if (thread_.joinable()) thread_.join();
+   }
+
+private:
+   struct connection : std::enable_shared_from_this<connection> {
+      bench_server& server;
+      websocket::stream<beast::tcp_stream> ws;
+      beast::flat_buffer buffer;
+
+      connection(bench_server& s, tcp::socket socket) : server(s), ws(std::move(socket)) {}
+
+      void run()
+      {
+         if (server.deflate_) {
+            websocket::permessage_deflate pmd;
+            pmd.server_enable = true;
+            ws.set_option(pmd);
+         }
+         ws.async_accept([self = shared_from_this()](error_code ec) {
+            if (ec) { self->server.errors++; return; }
+            self->read();
+         });
+      }
+
+      void read()
+      {
+         ws.async_read(buffer, [self = shared_from_this()](error_code ec, std::size_t n) {
+            if (ec) return;
+            self->on_message(n);
+            self->read();
+         });
+      }
+
+      void on_message(std::size_t n)
+      {
+         server.messages++;
+         server.bytes += n;
+         net::mutable_buffer terminator = buffer.prepare(1);
+         static_cast<char*>(terminator.data())[0] = '\0';
+         message_peek peek;
+         if (!peek.peek(static_cast<const char*>(buffer.data().data()), buffer.size(), ws.got_binary()))
+            server.errors++;
+         else if (peek.op.is("publish"))
+            server.publishes++;
+         else if (peek.op.is("subscribe"))
+            server.subscribes++;
+         buffer.consume(buffer.size());
+      }
+   };
+
+   net::io_context ioc_;
+   tcp::acceptor acceptor_;
+   bool deflate_;
+   std::thread thread_;
+
+   void accept()
+   {
+      acceptor_.async_accept([this](error_code ec, tcp::socket socket) {
+         if (!ec) std::make_shared<connection>(*this, std::move(socket))->run();
+         accept();
+      });
+   }
+};
+
+// bridge side, the same components and publish path as mohses_ros_bridge
+net::io_context ioc;
+auto iocWork = net::make_work_guard(ioc);
+signal_registry nodeData;
+ros_fanout fanout;
+latency_tracer tracer;
+ros_publisher publisher(nodeData, fanout, tracer);
+publish_scheduler scheduler(ioc);
+
+std::vector<signal_registry::signal_id> signalIds;
+std::vector<std::size_t> waveformIndexes;
+
+int64_t steadyNow() {
+   return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// phys values and waveforms as in onIngestEvent in rosBridge.cpp, control
+// events are only counted
+std::atomic<uint64_t> controlEvents{0};
+void onIngestEvent(const ingest_event& event) {
+   switch (event.type) {
+      case ingest_event::phys_value :
+      case ingest_event::waveform_sample :
+         publisher.on_ingest(event);
+         break;
+      case ingest_event::tick :
+      case ingest_event::sim_control :
+         controlEvents++;
+         break;
+   }
+}
+ingest_pipeline ingest(ioc, onIngestEvent);
+
+// a bridge configuration with the synthetic signals and waveforms
+void compile(message_template::encoding encoding) {
+   bridge_config config;
+   publish_mapping phys;
+   phys.topic = "/bench/physiology";
+   phys.field = "physiologyvalue";
+   for (int i = 0; i < args.signals; ++i)
+      phys.signals.push_back({"Bench_Signal_" + std::to_string(i), args.rate});
+   config.publish.push_back(phys);
+   config.waveforms.topic = "/bench/waveform";
+   config.waveforms.window = args.window;
+   for (int i = 0; i < args.waveforms; ++i)
+      config.waveforms.names.push_back("Bench_Waveform_" + std::to_string(i));
+
+   publisher.compile(config, encoding);
+   publisher.schedule(scheduler);
+
+   for (const signal_mapping& signal : phys.signals)
+      signalIds.push_back(nodeData.find(signal.name));
+   for (const std::string& name : config.waveforms.names) {
+      waveformIndexes.push_back(publisher.waveform(name));
+      publisher.set_waveform_unit(waveformIndexes.back(), "mV");
+   }
+}
+
+// synthetic DDS listener: calls fn(now) hz times per second until stopped
+template <typename Fn>
+std::thread driver(double hz, std::atomic<bool>& running, Fn fn) {
+   return std::thread([hz, &running, fn]() mutable {
+      auto period = duration_cast<steady_clock::duration>(duration<double>(1.0 / hz));
+      auto next = steady_clock::now();
+      while (running) {
+         fn();
+         next += period;
+         std::this_thread::sleep_until(next);
+      }
+   });
+}
+
+void printLatency(int topic, latency_tracer::stage stage) {
+   const latency_histogram& h = tracer.histogram(topic, stage);
+   if (h.count() == 0) return;
+   printf("  %-18s %-17s n=%-8llu p50=%9.1f p90=%9.1f p99=%9.1f p99.9=%9.1f max=%9.1f us\n",
+          tracer.topic_name(topic).c_str(), latency_tracer::stage_name(stage),
+          (unsigned long long)h.count(),
+          h.percentile(50) / 1000.0, h.percentile(90) / 1000.0, h.percentile(99) / 1000.0,
+          h.percentile(99.9) / 1000.0, h.max() / 1000.0);
+}
+
+int main(int argc, char *argv[]) {
+   argp_parse(&argp, argc, argv, 0, 0, &args);
+
+   static plog::ColorConsoleAppender<plog::TxtFormatter> consoleAppender;
+   plog::init(args.verbose ? plog::verbose : plog::warning, &consoleAppender);
+
+   bench_server server(args.deflate);
+   server.start();
+   std::string port = std::to_string(server.port());
+
+   endpoint_options options;
+   options.queue_size = args.queue_depth;
+   options.binary = args.cbor;
+   options.deflate = args.deflate;
+   options.tracer = &tracer;
+   options.verbose = args.verbose;
+   for (int i = 0; i < args.endpoints; ++i)
+      fanout.add(std::make_shared<ros_endpoint>(ioc, "127.0.0.1", port, "/", options));
+
+   compile(args.cbor ? message_template::encoding::cbor : message_template::encoding::json);
+   std::size_t physSource = ingest.add_source(4096);
+   std::size_t waveformSource = ingest.add_source(16384);
+   std::size_t controlSource = ingest.add_source(64);
+
+   fanout.start();
+   scheduler.start();
+   std::thread ioThread([]() { ioc.run(); });
+
+   // wait for all connections before measuring
+   auto deadline = steady_clock::now() + seconds(5);
+   for (;;) {
+      bool all = true;
+      for (const auto& endpoint : fanout.endpoints()) all = all && endpoint->connected();
+      if (all) break;
+      if (steady_clock::now() > deadline) {
+         fprintf(stderr, "could not connect to the bench server\n");
+         ioc.stop();
+         ioThread.join();
+         server.stop();
+         return EXIT_FAILURE;
+      }
+      std::this_thread::sleep_for(milliseconds(10));
+   }
+
+   std::size_t allocationsBefore = allocations.load();
+   uint64_t messagesBefore = server.messages, bytesBefore = server.bytes;
+   auto start = steady_clock::now();
+
+   std::atomic<bool> running{true};
+   std::vector<std::thread> drivers;
+   int step = 0;
+   drivers.push_back(driver(args.phys_hz, running, [&, step]() mutable {
+      int64_t now = steadyNow();
+      ++step;
+      for (std::size_t i = 0; i < signalIds.size(); ++i) {
+         // same work as OnPhysiologyValue: look up by name, push the sample
+         signal_registry::signal_id id = nodeData.find(nodeData.name(signalIds[i]));
+         nodeData.set_unit(id, "1/min");
+         ingest_event event = {ingest_event::phys_value, id, 60.0 + (step + i) % 40, now, 0, 0};
+         ingest.push(physSource, event);
+      }
+   }));
+   if (!waveformIndexes.empty()) {
+      drivers.push_back(driver(args.waveform_hz, running, [&, step]() mutable {
+         int64_t now = steadyNow();
+         ++step;
+         for (std::size_t i = 0; i < waveformIndexes.size(); ++i) {
+            ingest_event event = {ingest_event::waveform_sample, (int32_t)waveformIndexes[i], std::sin(step * 0.05 + i), now, 0, 0};
+            ingest.push(waveformSource, event);
+         }
+      }));
+   }
+   drivers.push_back(driver(50.0, running, [&, step]() mutable {
+      ingest_event event = {ingest_event::tick, 0, 0.0, steadyNow(), 0, ++step};
+      ingest.push(controlSource, event);
+   }));
+
+   std::this_thread::sleep_for(seconds(args.duration));
+   running = false;
+   for (auto& d : drivers) d.join();
+   // let the queues drain
+   std::this_thread::sleep_for(milliseconds(200));
+
+   double elapsed = duration<double>(steady_clock::now() - start).count();
+   std::size_t allocationCount = allocations.load() - allocationsBefore;
+   uint64_t messages = server.messages - messagesBefore;
+   uint64_t bytes = server.bytes - bytesBefore;
+
+   net::post(ioc, []() {
+      scheduler.stop();
+      fanout.stop();
+      iocWork.reset();
+   });
+   ioThread.join();
+   server.stop();
+
+   printf("ros_bridge_bench: %d signals @ %.0f Hz (publish %.0f Hz), %d waveforms @ %.0f Hz, %d endpoint(s), %s%s, %.1f s\n",
+          args.signals, args.phys_hz, args.rate, args.waveforms, args.waveform_hz, args.endpoints,
+          args.cbor ? "cbor" : "json", args.deflate ? " + deflate" : "", elapsed);
+   printf("  received  %10.0f msgs/s %12.0f bytes/s  (%llu publishes, %llu errors)\n",
+          messages / elapsed, bytes / elapsed,
+          (unsigned long long)server.publishes.load(), (unsigned long long)server.errors.load());
+   printf("  allocations %8.0f /s   %8.2f per message\n",
+          allocationCount / elapsed, messages ? (double)allocationCount / messages : 0.0);
+   printf("  outbound pool %zu messages, %zu reused, %zu allocated when empty\n",
+          fanout.pool().size(), fanout.pool().hits(), fanout.pool().misses());
+   printf("  ingest dropped %zu, control events %llu\n", ingest.dropped(), (unsigned long long)controlEvents.load());
+   for (const auto& endpoint : fanout.endpoints()) {
+      queue_stats stats = endpoint->stats();
+      printf("  endpoint queue: coalesced %zu, dropped oldest %zu, dropped newest %zu\n",
+             stats.coalesced, stats.dropped_oldest, stats.dropped_newest);
+   }
+   printf("latency:\n");
+   for (std::size_t t = 0; t < tracer.topics(); ++t)
+      for (int s = latency_tracer::receive_to_enqueue; s < latency_tracer::stages; ++s)
+         printLatency((int)t, (latency_tracer::stage)s);
+   return EXIT_SUCCESS;
+}
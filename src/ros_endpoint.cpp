@@ -0,0 +1,213 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#include <algorithm>
+
+#include "amm/BaseLogger.h"
+#include "ros_endpoint.hpp"
+
+ros_endpoint::ros_endpoint(net::io_context& ioc, std::string host, std::string port, std::string target,
+                           const endpoint_options& options)
+   : ioc_(ioc)
+   , host_(std::move(host))
+   , port_(std::move(port))
+   , target_(std::move(target))
+   , options_(options)
+   , reconnect_timer_(ioc)
+   , backoff_(options.reconnect_min)
+   , jitter_(std::random_device()())
+{
+}
+
+void ros_endpoint::set_keys(const std::vector<std::string>& keys)
+{
+   keys_ = keys;
+}
+
+void ros_endpoint::on_handshake(handshake_handler h)
+{
+   handshake_ = std::move(h);
+}
+
+void ros_endpoint::on_read(read_handler h)
+{
+   read_ = std::move(h);
+}
+
+void ros_endpoint::start()
+{
+   net::post(ioc_, [self = shared_from_this()]() {
+      self->stopped_ = false;
+      self->connect();
+   });
+}
+
+void ros_endpoint::stop()
+{
+   net::post(ioc_, [self = shared_from_this()]() {
+      self->stopped_ = true;
+      self->reconnect_timer_.cancel();
+      std::shared_ptr<ros_session> session = std::atomic_load(&self->session_);
+      if (session) session->do_close();
+   });
+}
+
+// runs on the io_context
+void ros_endpoint::connect()
+{
+   std::shared_ptr<ros_session> session;
+   if (options_.transport == transport_type::tcp) {
+      session = std::make_shared<tcp_session>(ioc_, options_.queue_size);
+   } else {
+      auto ws = std::make_shared<websocket_session>(ioc_, options_.queue_size);
+      if (options_.deflate)
+         ws->set_deflate(options_.deflate_window, options_.deflate_level, options_.deflate_threshold);
+      ws->set_binary(options_.binary);
+      session = std::move(ws);
+   }
+   session->set_verbose(options_.verbose);
+   session->set_queue_policy(options_.policy);
+   session->set_tracer(options_.tracer);
+   session->set_fragment_size(options_.fragment_size);
+   session->set_socket_options(options_.socket);
+   for (const std::string& key : keys_)
+      session->coalesce_key(key);
+
+   // the session must not keep its endpoint alive
+   std::weak_ptr<ros_endpoint> weak = shared_from_this();
+   session->registerHandshakeCallback([weak](std::string) {
+      auto self = weak.lock();
+      if (!self) return;
+      self->connected_ = true;
+      self->backoff_ = self->options_.reconnect_min;
+      if (self->handshake_) self->handshake_(*self);
+   });
+   session->registerReadCallback([weak](net::mutable_buffer msg, bool binary) {
+      auto self = weak.lock();
+      if (self && self->read_) self->read_(msg, binary);
+   });
+   session->registerCloseCallback([weak]() {
+      auto self = weak.lock();
+      if (self) net::post(self->ioc_, [self]() { self->session_closed(); });
+   });
+
+   std::atomic_store(&session_, session);
+   LOG_INFO << "Connecting to ROS instance " << host_ << ":" << port_;
+   session->run(host_, port_, target_);
+}
+
+// runs on the io_context
+void ros_endpoint::session_closed()
+{
+   connected_ = false;
+   std::shared_ptr<ros_session> session = std::atomic_exchange(&session_, std::shared_ptr<ros_session>());
+   if (session) {
+      queue_stats last = session->stats();
+      closed_.coalesced += last.coalesced;
+      closed_.dropped_oldest += last.dropped_oldest;
+      closed_.dropped_newest += last.dropped_newest;
+      closed_.fragmented += last.fragmented;
+      closed_.written += last.written;
+      closed_.written_bytes += last.written_bytes;
+   }
+   LOG_INFO << "Connection to ROS instance " << host_ << ":" << port_ << " closed.";
+   if (stopped_) return;
+
+   // wait a while before trying to reconnect
+   std::chrono::milliseconds delay = next_delay();
+   ++reconnects_;
+   if ( options_.verbose )
+      LOG_DEBUG << "Reconnecting to " << host_ << ":" << port_ << " in " << delay.count() << " ms";
+   reconnect_timer_.expires_after(delay);
+   reconnect_timer_.async_wait([self = shared_from_this()](error_code ec) {
+      if (!ec && !self->stopped_) self->connect();
+   });
+}
+
+// delay before the next attempt: half the current backoff plus a random
+// part of the other half. The backoff doubles until a handshake succeeds.
+std::chrono::milliseconds ros_endpoint::next_delay()
+{
+   std::chrono::milliseconds::rep half = backoff_.count() / 2;
+   std::uniform_int_distribution<std::chrono::milliseconds::rep> jitter(0, backoff_.count() - half);
+   std::chrono::milliseconds delay(half + jitter(jitter_));
+   backoff_ = std::min(backoff_ * 2, options_.reconnect_max);
+   return delay;
+}
+
+void ros_endpoint::write(const shared_message& message, int key)
+{
+   if (!connected_) return;
+   std::shared_ptr<ros_session> session = std::atomic_load(&session_);
+   if (session) session->do_write(message, key);
+}
+
+queue_stats ros_endpoint::stats() const
+{
+   queue_stats stats = closed_;
+   stats.depth = 0;
+   stats.capacity = options_.queue_size;
+   std::shared_ptr<ros_session> session = std::atomic_load(&session_);
+   if (!session) return stats;
+   queue_stats current = session->stats();
+   stats.depth = current.depth;
+   stats.capacity = current.capacity;
+   stats.coalesced += current.coalesced;
+   stats.dropped_oldest += current.dropped_oldest;
+   stats.dropped_newest += current.dropped_newest;
+   stats.fragmented += current.fragmented;
+   stats.written += current.written;
+   stats.written_bytes += current.written_bytes;
+   return stats;
+}
+
+void ros_fanout::add(std::shared_ptr<ros_endpoint> endpoint)
+{
+   endpoints_.push_back(std::move(endpoint));
+}
+
+int ros_fanout::coalesce_key(const std::string& key)
+{
+   for (std::size_t i = 0; i < keys_.size(); ++i)
+      if (keys_[i] == key) return (int)i;
+   if (keys_.size() >= max_keys) {
+      LOG_ERROR << "Too many coalescing keys, not coalescing " << key;
+      return -1;
+   }
+   keys_.push_back(key);
+   return (int)keys_.size() - 1;
+}
+
+void ros_fanout::start()
+{
+   // enough messages for full queues, one pending message per key and
+   // one write in flight on every endpoint
+   std::size_t count = 0;
+   for (auto& endpoint : endpoints_)
+      count += endpoint->stats().capacity + keys_.size() + 1;
+   if (pool_.size() == 0) pool_.reserve(count, message_capacity);
+
+   for (auto& endpoint : endpoints_) {
+      endpoint->set_keys(keys_);
+      endpoint->start();
+   }
+}
+
+void ros_fanout::stop()
+{
+   for (auto& endpoint : endpoints_)
+      endpoint->stop();
+}
+
+void ros_fanout::write(const shared_message& message, int key)
+{
+   for (auto& endpoint : endpoints_)
+      endpoint->write(message, key);
+}
+
+bool ros_fanout::connected() const
+{
+   for (const auto& endpoint : endpoints_)
+      if (endpoint->connected()) return true;
+   return false;
+}
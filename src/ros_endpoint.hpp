@@ -0,0 +1,142 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "message_pool.hpp"
+#include "tcp_session.hpp"
+#include "websocket_session.hpp"
+
+/**
+ * @brief How an endpoint talks to its rosbridge server
+ */
+enum class transport_type {
+   websocket,   // rosbridge_websocket
+   tcp          // rosbridge_tcp, json only
+};
+
+/**
+ * @brief Settings applied to every session of an endpoint
+ */
+struct endpoint_options {
+   transport_type transport = transport_type::websocket;
+   std::size_t queue_size = 1024;
+   queue_policy policy = queue_policy::drop_oldest;
+   bool binary = false;
+   bool deflate = false;
+   int deflate_window = 15;
+   int deflate_level = 8;
+   std::size_t deflate_threshold = 0;
+   std::size_t fragment_size = 0;                  // 0: never fragment
+   socket_options socket;
+   std::chrono::milliseconds reconnect_min{25};    // first reconnect delay
+   std::chrono::milliseconds reconnect_max{5000};  // backoff limit
+   latency_tracer* tracer = nullptr;
+   bool verbose = false;
+};
+
+/**
+ * @brief Ros_Endpoint Class keeps a connection to one rosbridge server.
+ *
+ * Every connection attempt uses a fresh session of its transport, with its
+ * own outbound queue. When a session ends the endpoint reconnects on its own
+ * timer, independent of other endpoints. The delay starts at reconnect_min
+ * and doubles with every failed attempt up to reconnect_max, with jitter so
+ * endpoints and bridges do not retry in lockstep.
+ */
+class ros_endpoint : public std::enable_shared_from_this<ros_endpoint>
+{
+public:
+   typedef std::function<void(ros_endpoint&)> handshake_handler;
+   typedef std::function<void(net::mutable_buffer, bool)> read_handler;
+
+   ros_endpoint(net::io_context& ioc, std::string host, std::string port, std::string target,
+                const endpoint_options& options);
+
+   const std::string& host() const { return host_; }
+   const std::string& port() const { return port_; }
+   bool connected() const { return connected_; }
+
+   // coalescing keys registered with every session, in order, so the key
+   // ids of all sessions and endpoints are the same. Call before start().
+   void set_keys(const std::vector<std::string>& keys);
+   void on_handshake(handshake_handler h);
+   void on_read(read_handler h);
+
+   void start();
+   void stop();
+
+   // may be called from any thread. Dropped unless the session is connected.
+   void write(const shared_message& message, int key = -1);
+   // queue of the current session, counters summed over all sessions.
+   // On the io_context, or once it stopped.
+   queue_stats stats() const;
+   // connections lost and attempted again
+   std::size_t reconnects() const { return reconnects_; }
+
+private:
+   net::io_context& ioc_;
+   std::string host_;
+   std::string port_;
+   std::string target_;
+   endpoint_options options_;
+   std::vector<std::string> keys_;
+   handshake_handler handshake_;
+   read_handler read_;
+
+   std::shared_ptr<ros_session> session_;   // accessed with std::atomic_load/store
+   std::atomic<bool> connected_{false};
+   bool stopped_ = false;
+   queue_stats closed_ = {};             // counters of the sessions that ended
+   std::atomic<std::size_t> reconnects_{0};
+   net::steady_timer reconnect_timer_;
+   std::chrono::milliseconds backoff_;
+   std::minstd_rand jitter_;
+
+   void connect();
+   std::chrono::milliseconds next_delay();
+   void session_closed();
+};
+
+/**
+ * @brief Ros_Fanout writes each message to all connected endpoints.
+ *
+ * A message is serialized once and the same buffer is queued by every
+ * endpoint, so a slow endpoint only fills its own queue. Messages come from
+ * a pool sized at start() for the queues of all endpoints, and go back to
+ * it once the last endpoint has written or dropped them.
+ */
+class ros_fanout
+{
+public:
+   void add(std::shared_ptr<ros_endpoint> endpoint);
+   const std::vector<std::shared_ptr<ros_endpoint>>& endpoints() const { return endpoints_; }
+
+   // register a coalescing key (topic or signal name) and return its id
+   int coalesce_key(const std::string& key);
+
+   void start();
+   void stop();
+
+   // may be called from any thread. Render into an acquired message and
+   // pass it to write().
+   std::shared_ptr<outbound_message> acquire() { return pool_.acquire(); }
+   void write(const shared_message& message, int key = -1);
+   bool connected() const;
+   const message_pool& pool() const { return pool_; }
+
+private:
+   static const std::size_t max_keys = 256;
+   static const std::size_t message_capacity = 512;
+   std::vector<std::shared_ptr<ros_endpoint>> endpoints_;
+   std::vector<std::string> keys_;
+   message_pool pool_;
+};
@@ -0,0 +1,375 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bridge_config.hpp"
+#include "message_template.hpp"
+
+/**
+ * Rosbridge ops and ROS messages, each described once as a struct.
+ *
+ * Every message struct lists its fields in order in
+ *
+ *    template <typename Fields> void fields(Fields& f) const;
+ *
+ * calling f("name", value) per field. Field names are string literals, so
+ * their lengths are known at compile time. A message is written with
+ * serialize() to any writer with the rapidjson Writer interface: a
+ * json_writer or cbor_writer straight into an output buffer, or the
+ * template_builder of message_template::compile() to build a template.
+ *
+ * Values are strings, numbers, bools, nested message structs, vectors, and
+ * the placeholders below, which only a template_builder accepts: using
+ * them with a plain writer does not compile.
+ */
+namespace ros {
+
+// number filled in when the template is rendered
+struct slot {};
+// string filled in when the template is rendered
+struct text_slot {};
+// array whose items are appended when the template is rendered
+struct spliced_array {};
+
+// field left out of the message unless set
+template <typename T>
+struct optional {
+   T value{};
+   bool set = false;
+
+   optional() = default;
+   optional(T v, bool s = true) : value(std::move(v)), set(s) {}
+};
+
+// optional string, left out when empty
+inline optional<std::string> unless_empty(const std::string& s)
+{
+   return optional<std::string>(s, !s.empty());
+}
+
+// optional number, left out unless positive
+inline optional<int> when_positive(int n)
+{
+   return optional<int>(n, n > 0);
+}
+
+// field whose name is only known at runtime, e.g. from the configuration
+template <typename T>
+struct named {
+   const std::string& name;
+   const T& value;
+};
+
+template <typename T>
+named<T> make_named(const std::string& name, const T& value)
+{
+   return named<T>{name, value};
+}
+
+// string that is not a std::string, e.g. a slice of another message
+struct text_view {
+   const char* data;
+   std::size_t length;
+};
+
+// object of string fields, e.g. configured event messages
+struct string_fields {
+   const std::vector<std::pair<std::string, std::string>>& fields;
+};
+
+template <typename W>
+class serializer
+{
+   W& w_;
+
+public:
+   explicit serializer(W& w) : w_(w) {}
+
+   template <std::size_t N, typename T>
+   void operator()(const char (&name)[N], const T& v)
+   {
+      w_.Key(name, (rapidjson::SizeType)(N - 1));
+      value(v);
+   }
+
+   template <std::size_t N, typename T>
+   void operator()(const char (&name)[N], const optional<T>& v)
+   {
+      if (!v.set) return;
+      w_.Key(name, (rapidjson::SizeType)(N - 1));
+      value(v.value);
+   }
+
+   template <typename T>
+   void operator()(const named<T>& field)
+   {
+      w_.Key(field.name.c_str(), (rapidjson::SizeType)field.name.size());
+      value(field.value);
+   }
+
+   template <std::size_t N>
+   void value(const char (&s)[N]) { w_.String(s, (rapidjson::SizeType)(N - 1)); }
+   void value(const std::string& s) { w_.String(s.c_str(), (rapidjson::SizeType)s.size()); }
+   void value(text_view s) { w_.String(s.data, (rapidjson::SizeType)s.length); }
+   void value(bool b) { w_.Bool(b); }
+   void value(int i) { w_.Int(i); }
+   void value(unsigned u) { w_.Uint(u); }
+   void value(int64_t i) { w_.Int64(i); }
+   void value(double d) { w_.Double(d); }
+   void value(slot) { w_.Slot(); }
+   void value(text_slot) { w_.TextSlot(); }
+
+   void value(spliced_array)
+   {
+      w_.StartArray();
+      w_.Splice();
+      w_.EndArray();
+   }
+
+   void value(const string_fields& object)
+   {
+      w_.StartObject();
+      for (const auto& field : object.fields) {
+         w_.Key(field.first.c_str(), (rapidjson::SizeType)field.first.size());
+         value(field.second);
+      }
+      w_.EndObject();
+   }
+
+   template <typename T>
+   void value(const std::vector<T>& items)
+   {
+      w_.StartArray();
+      for (const T& item : items) value(item);
+      w_.EndArray();
+   }
+
+   template <typename M>
+   auto value(const M& message) -> decltype(message.fields(*this), void())
+   {
+      w_.StartObject();
+      message.fields(*this);
+      w_.EndObject();
+   }
+};
+
+template <typename W, typename M>
+void serialize(W& writer, const M& message)
+{
+   serializer<W> s(writer);
+   s.value(message);
+}
+
+// append message to out in the given encoding
+template <typename M>
+void serialize(message_template::encoding enc, const M& message, std::string& out)
+{
+   if (enc == message_template::encoding::cbor) {
+      cbor_writer writer(out);
+      serialize(writer, message);
+   } else {
+      string_output os{out};
+      json_writer writer(os);
+      serialize(writer, message);
+   }
+}
+
+// template of a message containing placeholders
+template <typename M>
+message_template compile(message_template::encoding enc, const M& message)
+{
+   return message_template::compile(enc, [&](auto& w) { serialize(w, message); });
+}
+
+// rosbridge ops
+
+struct advertise_op {
+   const std::string& topic;
+   const std::string& type;
+
+   template <typename F> void fields(F& f) const
+   {
+      f("op", "advertise");
+      f("topic", topic);
+      f("type", type);
+   }
+};
+
+struct unadvertise_op {
+   const std::string& topic;
+
+   template <typename F> void fields(F& f) const
+   {
+      f("op", "unadvertise");
+      f("topic", topic);
+   }
+};
+
+template <typename Msg>
+struct publish_op {
+   const std::string& topic;
+   Msg msg;
+
+   template <typename F> void fields(F& f) const
+   {
+      f("op", "publish");
+      f("topic", topic);
+      f("msg", msg);
+   }
+};
+
+template <typename Msg>
+publish_op<Msg> publish(const std::string& topic, Msg msg)
+{
+   return publish_op<Msg>{topic, std::move(msg)};
+}
+
+struct subscribe_op {
+   const std::string& topic;
+   optional<std::string> type;
+   optional<int> throttle_rate;
+   optional<int> queue_length;
+   optional<int> fragment_size;
+   optional<std::string> compression;
+
+   template <typename F> void fields(F& f) const
+   {
+      f("op", "subscribe");
+      f("topic", topic);
+      f("type", type);
+      f("throttle_rate", throttle_rate);
+      f("queue_length", queue_length);
+      f("fragment_size", fragment_size);
+      f("compression", compression);
+   }
+};
+
+struct unsubscribe_op {
+   const std::string& topic;
+
+   template <typename F> void fields(F& f) const
+   {
+      f("op", "unsubscribe");
+      f("topic", topic);
+   }
+};
+
+// service call, answered by a service_response op with the same id
+template <typename Args>
+struct call_service_op {
+   const std::string& id;
+   const std::string& service;
+   Args args;
+   optional<std::string> type;
+
+   template <typename F> void fields(F& f) const
+   {
+      f("op", "call_service");
+      f("id", id);
+      f("service", service);
+      f("type", type);
+      f("args", args);
+   }
+};
+
+// part num of total of a message too large to send at once. data is a
+// slice of the message text, the receiver joins the slices of an id.
+struct fragment_op {
+   const std::string& id;
+   text_view data;
+   int num;
+   int total;
+
+   template <typename F> void fields(F& f) const
+   {
+      f("op", "fragment");
+      f("id", id);
+      f("data", data);
+      f("num", num);
+      f("total", total);
+   }
+};
+
+// ROS messages
+
+// {field: {"name":..,"value":..}}
+struct physiology_value_msg {
+   const std::string& field;
+   const std::string& name;
+
+   struct value_type {
+      const std::string& name;
+      template <typename F> void fields(F& f) const
+      {
+         f("name", name);
+         f("value", slot());
+      }
+   };
+
+   template <typename F> void fields(F& f) const
+   {
+      f(make_named(field, value_type{name}));
+   }
+};
+
+// batch entry {"name":..,"value":..,"unit":..,"sim_time":..}
+struct physiology_entry {
+   const std::string& name;
+
+   template <typename F> void fields(F& f) const
+   {
+      f("name", name);
+      f("value", slot());
+      f("unit", text_slot());
+      f("sim_time", slot());
+   }
+};
+
+// {field: [entries]}
+struct physiology_batch_msg {
+   const std::string& field;
+
+   template <typename F> void fields(F& f) const
+   {
+      f(make_named(field, spliced_array()));
+   }
+};
+
+// {"name":..,"unit":..,"start_time":..,"sample_rate":..,"samples":[...]}
+struct waveform_chunk_msg {
+   const std::string& name;
+
+   template <typename F> void fields(F& f) const
+   {
+      f("name", name);
+      f("unit", text_slot());
+      f("start_time", slot());
+      f("sample_rate", slot());
+      f("samples", spliced_array());
+   }
+};
+
+// {"type":.., param fields}, numbers or strings as configured
+struct modification_msg {
+   const std::string& type;
+   const std::vector<modification_param>& params;
+
+   template <typename F> void fields(F& f) const
+   {
+      f("type", type);
+      for (const modification_param& param : params) {
+         if (param.text)
+            f(make_named(param.field, text_slot()));
+         else
+            f(make_named(param.field, slot()));
+      }
+   }
+};
+
+}
@@ -0,0 +1,278 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#include <chrono>
+#include <cmath>
+
+#include "amm/BaseLogger.h"
+#include "ros_messages.hpp"
+#include "ros_publisher.hpp"
+
+using namespace std::chrono;
+
+ros_publisher::ros_publisher(signal_registry& signals, ros_fanout& fanout, latency_tracer& tracer)
+   : signals_(signals)
+   , fanout_(fanout)
+   , tracer_(tracer)
+{
+}
+
+// compile the AMM to ROS mapping into message templates. Messages are
+// rendered from these templates; only values are formatted per message.
+void ros_publisher::compile(const bridge_config& config, message_template::encoding enc)
+{
+   for (const publish_mapping& mapping : config.publish) {
+      phys_publish pub;
+      pub.batch = mapping.batch;
+      pub.rate = mapping.rate;
+      pub.trace_topic = tracer_.topic(mapping.topic);
+      for (const signal_mapping& signal : mapping.signals) {
+         const std::string& name = signal.name;
+         signal_registry::signal_id id = signals_.intern(name);
+         if (id == signal_registry::invalid_id) {
+            LOG_ERROR << "Too many phys values, ignoring " << name;
+            continue;
+         }
+         pub.ids.push_back(id);
+         pub.rates.push_back(signal.rate);
+         pub.deadbands.push_back(signal.deadband);
+         pub.last_sent.push_back(std::nan(""));
+         if ( mapping.batch ) {
+            pub.templates.push_back(ros::compile(enc, ros::physiology_entry{name}));
+         } else {
+            pub.templates.push_back(ros::compile(enc,
+               ros::publish(mapping.topic, ros::physiology_value_msg{mapping.field, name})));
+            pub.keys.push_back(fanout_.coalesce_key(mapping.topic + ":" + name));
+         }
+      }
+      if ( mapping.batch ) {
+         pub.envelope = ros::compile(enc, ros::publish(mapping.topic, ros::physiology_batch_msg{mapping.field}));
+         pub.batch_key = fanout_.coalesce_key(mapping.topic);
+      }
+      publishes_.push_back(std::move(pub));
+   }
+   sim_time_ = signals_.find("SIM_TIME");
+
+   const std::string& topic = config.waveforms.topic;
+   waveform_topic_ = tracer_.topic(topic);
+   waveform_window_ = (int64_t)config.waveforms.window * 1000000;
+   for (const std::string& name : config.waveforms.names) {
+      if (waveform_index_.count(name)) continue;
+      waveform_templates_.push_back(ros::compile(enc, ros::publish(topic, ros::waveform_chunk_msg{name})));
+      // preallocate waveform buffers for 2 seconds at 500 Hz
+      waveform_buffers_.emplace_back(new waveform_buffer(name, 1024));
+      waveform_index_[name] = waveform_buffers_.size() - 1;
+   }
+}
+
+void ros_publisher::schedule(publish_scheduler& scheduler)
+{
+   for (phys_publish& pub : publishes_) {
+      if ( pub.batch ) {
+         scheduler.add(pub.rate, [this, &pub]() { publish_batch(pub); });
+         continue;
+      }
+      for (std::size_t i = 0; i < pub.ids.size(); ++i)
+         scheduler.add(pub.rates[i], [this, &pub, i]() { publish_value(pub, i); });
+   }
+   // checked twice per window, so a partial window goes out at most half a
+   // window late
+   if (waveform_window_ <= 0) return;
+   for (std::size_t i = 0; i < waveform_buffers_.size(); ++i)
+      scheduler.add(2e9 / waveform_window_, [this, i]() { flush_waveform(i); });
+}
+
+std::size_t ros_publisher::signals() const
+{
+   std::size_t count = 0;
+   for (const phys_publish& pub : publishes_) count += pub.ids.size();
+   return count;
+}
+
+void ros_publisher::write(std::shared_ptr<outbound_message> message, int key, ros_endpoint* endpoint,
+                          message_trace trace, int topic)
+{
+   if (hook_) hook_(topic < 0 ? trace.topic : topic, message->data);
+   message->trace = trace;
+   message->trace.enqueued = latency_tracer::now();
+   shared_message shared = std::move(message);
+   if ( endpoint )
+      endpoint->write(shared, key);
+   else
+      fanout_.write(shared, key);
+}
+
+void ros_publisher::write_value(const phys_publish& pub, std::size_t i, const signal_registry::sample& sample, ros_endpoint* endpoint)
+{
+   std::shared_ptr<outbound_message> message = fanout_.acquire();
+   template_fill(pub.templates[i], message->data).number(sample.value);
+   message_trace trace;
+   trace.topic = endpoint ? -1 : pub.trace_topic;   // state resent on reconnect is not traced
+   trace.source = sample.source;
+   trace.received = sample.timestamp;
+   write(std::move(message), pub.keys[i], endpoint, trace, pub.trace_topic);
+}
+
+// publish each phys value as a separate message
+void ros_publisher::write_values(const phys_publish& pub, ros_endpoint* endpoint)
+{
+   for (std::size_t i = 0; i < pub.ids.size(); ++i) {
+      signal_registry::sample sample = signals_.load(pub.ids[i]);
+      if (sample.valid())
+         write_value(pub, i, sample, endpoint);
+   }
+}
+
+// forward all selected phys values in a single publish
+void ros_publisher::write_batch(const phys_publish& pub, ros_endpoint* endpoint)
+{
+   double simSeconds = 0.0;
+   if (sim_time_ != signal_registry::invalid_id) {
+      signal_registry::sample simTime = signals_.load(sim_time_);
+      if (simTime.valid()) simSeconds = std::round(simTime.value * 10.0) / 10.0;
+   }
+
+   std::shared_ptr<outbound_message> message = fanout_.acquire();
+   template_fill envelope(pub.envelope, message->data);
+   // traced from the oldest value in the batch, unless resent on reconnect
+   message_trace trace;
+   trace.topic = endpoint ? -1 : pub.trace_topic;
+   bool first = true;
+   for (std::size_t i = 0; i < pub.ids.size(); ++i) {
+      signal_registry::sample sample = signals_.load(pub.ids[i]);
+      if (!sample.valid()) continue;
+      if (first || sample.timestamp < trace.received) {
+         trace.received = sample.timestamp;
+         trace.source = sample.source;
+      }
+      if (!first) pub.envelope.append_separator(message->data);
+      first = false;
+      template_fill(pub.templates[i], message->data)
+         .number(sample.value)
+         .text(signals_.unit(pub.ids[i]))
+         .number(simSeconds);
+   }
+   if (first) return;   // nothing received yet
+   envelope.splice();
+
+   write(std::move(message), pub.batch_key, endpoint, trace, pub.trace_topic);
+}
+
+void ros_publisher::write_phys_data(ros_endpoint* endpoint)
+{
+   for (const phys_publish& pub : publishes_) {
+      if ( pub.batch )
+         write_batch(pub, endpoint);
+      else
+         write_values(pub, endpoint);
+   }
+}
+
+// scheduled publishing of one value of a per-value mapping
+void ros_publisher::publish_value(phys_publish& pub, std::size_t i)
+{
+   if ( !fanout_.connected() ) return;
+   signal_registry::sample sample = signals_.load(pub.ids[i]);
+   if (!sample.valid()) return;
+   if (std::fabs(sample.value - pub.last_sent[i]) < pub.deadbands[i]) return;
+   pub.last_sent[i] = sample.value;
+   write_value(pub, i, sample, nullptr);
+}
+
+// scheduled publishing of a batch mapping. Skipped if every value is
+// within its deadband.
+void ros_publisher::publish_batch(phys_publish& pub)
+{
+   if ( !fanout_.connected() ) return;
+   bool changed = false;
+   for (std::size_t i = 0; i < pub.ids.size() && !changed; ++i) {
+      signal_registry::sample sample = signals_.load(pub.ids[i]);
+      changed = sample.valid() && !(std::fabs(sample.value - pub.last_sent[i]) < pub.deadbands[i]);
+   }
+   if (!changed) return;
+   for (std::size_t i = 0; i < pub.ids.size(); ++i)
+      pub.last_sent[i] = signals_.load(pub.ids[i]).value;
+   write_batch(pub, nullptr);
+}
+
+void ros_publisher::on_ingest(const ingest_event& event)
+{
+   switch (event.type) {
+      case ingest_event::phys_value :
+         // values are forwarded to ROS by the scheduled publishes
+         signals_.store(event.id, event.value, event.timestamp, event.source);
+         break;
+      case ingest_event::waveform_sample : {
+         // buffer samples of forwarded waveforms, send a chunk once the
+         // oldest buffered sample is a window length old
+         waveform_buffer& buffer = *waveform_buffers_[event.id];
+         buffer.push(event.value, event.timestamp);
+         if (event.timestamp - buffer.oldest() >= waveform_window_)
+            write_waveform_chunk(event.id, event.timestamp, event.source);
+         break;
+      }
+      default :
+         break;
+   }
+}
+
+std::size_t ros_publisher::waveform(const std::string& name) const
+{
+   auto it = waveform_index_.find(name);
+   return it == waveform_index_.end() ? npos : it->second;
+}
+
+void ros_publisher::set_waveform_unit(std::size_t index, const std::string& unit)
+{
+   waveform_buffers_[index]->set_unit(unit);
+}
+
+// scheduled: send the buffered samples of a waveform once the oldest one
+// is a window length old, when no newer sample arrived to complete the chunk
+void ros_publisher::flush_waveform(std::size_t index)
+{
+   waveform_buffer& buffer = *waveform_buffers_[index];
+   if (buffer.size() == 0) return;
+   int64_t now = latency_tracer::now();
+   if (now - buffer.oldest() >= waveform_window_)
+      write_waveform_chunk(index, now, 0);
+}
+
+// forward the buffered samples of one waveform as a single publish
+void ros_publisher::write_waveform_chunk(std::size_t index, int64_t now, int64_t source)
+{
+   waveform_buffer& waveform = *waveform_buffers_[index];
+   const message_template& tmpl = waveform_templates_[index];
+   std::size_t count = waveform.size();
+   if (count == 0) return;
+   if ( !fanout_.connected() ) {
+      waveform.consume(count, [](const waveform_buffer::sample&) {});
+      return;
+   }
+
+   // wall clock time of the first sample in the chunk
+   double startTime = duration<double>(system_clock::now().time_since_epoch()).count()
+                    - (now - waveform.oldest()) * 1e-9;
+   startTime = std::round(startTime * 1000.0) / 1000.0;
+   double sampleRate = std::round(waveform.sample_rate() * 10.0) / 10.0;
+
+   std::shared_ptr<outbound_message> message = fanout_.acquire();
+   message->data.reserve(tmpl.size() + 48 + count * 12);
+   template_fill chunk(tmpl, message->data);
+   chunk.text(waveform.unit()).number(startTime).number(sampleRate);
+   bool first = true;
+   waveform.consume(count, [&](const waveform_buffer::sample& s) {
+      if (!first) tmpl.append_separator(message->data);
+      first = false;
+      tmpl.append_number(message->data, s.value);
+   });
+   chunk.splice();
+
+   // chunks are never coalesced, every sample has to reach ROS. traced
+   // from the sample that completed the chunk, or from the flush.
+   message_trace trace;
+   trace.topic = waveform_topic_;
+   trace.source = source;
+   trace.received = now;
+   write(std::move(message), -1, nullptr, trace);
+}
@@ -0,0 +1,109 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bridge_config.hpp"
+#include "ingest_pipeline.hpp"
+#include "latency_tracer.hpp"
+#include "message_template.hpp"
+#include "publish_scheduler.hpp"
+#include "ros_endpoint.hpp"
+#include "signal_registry.hpp"
+#include "waveform_buffer.hpp"
+
+/**
+ * @brief Ros_Publisher Class forwards phys values and waveforms from AMM to
+ * ROS: it stores the ingested samples, publishes phys values on scheduler
+ * timers and writes waveform chunks, all rendered from message templates
+ * compiled from the publish and waveform mappings.
+ *
+ * mohses_ros_bridge and ros_bridge_bench share it, so the benchmark
+ * measures the code that ships. Everything but set_waveform_unit() runs
+ * on the I/O thread.
+ */
+class ros_publisher
+{
+public:
+   // called for every message written, with the tracer topic it counts for
+   // (-1 if none) and the rendered message
+   typedef std::function<void(int topic, const std::string& data)> write_hook;
+
+   ros_publisher(signal_registry& signals, ros_fanout& fanout, latency_tracer& tracer);
+
+   // compile the publish and waveform mappings. Interns the signal names;
+   // a SIM_TIME signal, if interned, is added to batches.
+   void compile(const bridge_config& config, message_template::encoding enc);
+   // publish tasks for the phys values, one per value or batch, and a
+   // flush task per waveform for chunks no new sample completes
+   void schedule(publish_scheduler& scheduler);
+   void on_write(write_hook hook) { hook_ = std::move(hook); }
+
+   // write a message rendered into fanout.acquire() to all connected ROS
+   // instances, or only to endpoint if given. It is serialized once, every
+   // endpoint queues the same buffer. topic: tracer topic id it is counted
+   // for, if it is not traced.
+   void write(std::shared_ptr<outbound_message> message, int key = -1, ros_endpoint* endpoint = nullptr,
+              message_trace trace = message_trace(), int topic = -1);
+
+   // the current phys values to all ROS instances, or only to endpoint
+   void write_phys_data(ros_endpoint* endpoint = nullptr);
+
+   // phys_value and waveform_sample events; others are ignored
+   void on_ingest(const ingest_event& event);
+
+   // waveform index of a name for waveform_sample events, npos if not forwarded
+   static const std::size_t npos = (std::size_t)-1;
+   std::size_t waveform(const std::string& name) const;
+   // from the DDS listener thread; the unit is kept from the first sample
+   void set_waveform_unit(std::size_t index, const std::string& unit);
+
+   std::size_t signals() const;
+   std::size_t topics() const { return publishes_.size(); }
+   std::size_t waveforms() const { return waveform_buffers_.size(); }
+
+private:
+   // publish mapping compiled into message templates
+   struct phys_publish {
+      bool batch = false;
+      double rate = 1.0;                         // batch: publishes per second
+      std::vector<signal_registry::signal_id> ids;
+      std::vector<double> rates;                 // per signal publishes per second
+      std::vector<double> deadbands;             // per signal publish-on-change threshold
+      std::vector<double> last_sent;             // per signal value last published
+      std::vector<message_template> templates;   // per signal: message or batch entry
+      std::vector<int> keys;                     // per signal coalescing keys
+      message_template envelope;                 // batch: message around the entries
+      int batch_key = -1;
+      int trace_topic = -1;
+   };
+
+   signal_registry& signals_;
+   ros_fanout& fanout_;
+   latency_tracer& tracer_;
+   write_hook hook_;
+   signal_registry::signal_id sim_time_ = signal_registry::invalid_id;
+
+   std::vector<phys_publish> publishes_;
+
+   // high frequency waveforms forwarded to ROS in chunks
+   std::vector<std::unique_ptr<waveform_buffer>> waveform_buffers_;
+   std::vector<message_template> waveform_templates_;
+   std::unordered_map<std::string, std::size_t> waveform_index_;
+   int64_t waveform_window_ = 50000000;   // chunk length in ns
+   int waveform_topic_ = -1;
+
+   void write_value(const phys_publish& pub, std::size_t i, const signal_registry::sample& sample, ros_endpoint* endpoint);
+   void write_values(const phys_publish& pub, ros_endpoint* endpoint);
+   void write_batch(const phys_publish& pub, ros_endpoint* endpoint);
+   void publish_value(phys_publish& pub, std::size_t i);
+   void publish_batch(phys_publish& pub);
+   void flush_waveform(std::size_t index);
+   void write_waveform_chunk(std::size_t index, int64_t now, int64_t source);
+};
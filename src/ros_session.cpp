@@ -0,0 +1,503 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "amm/BaseLogger.h"
+#include "ros_messages.hpp"
+#include "ros_session.hpp"
+
+ros_session::ros_session(net::io_context& ioc, std::size_t queue_size)
+   : strand_(net::make_strand(ioc))
+   , resolver_(strand_)
+   , close_timer_(strand_)
+   , message_queue(queue_size)
+   , pending_(new shared_message[max_keys])
+{
+}
+
+ros_session::~ros_session()
+{
+}
+
+void ros_session::run(
+   std::string host,
+   std::string port,
+   std::string target)
+{
+   // Save for later
+   host_ = host;
+   target_ = target;
+
+   // Look up the domain name
+   resolver_.async_resolve(
+      host,
+      port,
+      beast::bind_front_handler(
+            &ros_session::on_resolve,
+            shared_from_this()));
+}
+
+void ros_session::fail(error_code ec, char const* what)
+{
+   // Do report these
+   if( ec == net::error::operation_aborted ) {
+      LOG_ERROR << what << " operation aborted: " << ec.message();
+   } else if( ec == websocket::error::closed) {
+      LOG_ERROR << what << " " << transport() << " closed: " << ec.message();
+   } else {
+      LOG_ERROR << what << ": " << ec.message();
+   }
+   closed();
+}
+
+// the session is done; report it once, whichever operation noticed first
+void ros_session::closed()
+{
+   if (closed_) return;
+   closed_ = true;
+   if (closeCallback) closeCallback();
+}
+
+void ros_session::on_resolve(
+   error_code ec,
+   tcp::resolver::results_type results)
+{
+   if(ec) return fail(ec, "resolve");
+   for(tcp::endpoint const& endpoint : results) {
+      LOG_INFO << transport() << " resolved endpoint: " << endpoint;
+   }
+   connect(results);
+}
+
+// on the strand, once connected. TCP_NODELAY, buffer sizes and keepalive
+// as set with set_socket_options().
+void ros_session::apply_socket_options(tcp::socket& socket)
+{
+   error_code ec;
+   socket.set_option(tcp::no_delay(socket_options_.no_delay), ec);
+   if (ec) LOG_WARNING << transport() << " TCP_NODELAY: " << ec.message();
+   if (socket_options_.send_buffer > 0) {
+      socket.set_option(net::socket_base::send_buffer_size(socket_options_.send_buffer), ec);
+      if (ec) LOG_WARNING << transport() << " send buffer size: " << ec.message();
+   }
+   if (socket_options_.receive_buffer > 0) {
+      socket.set_option(net::socket_base::receive_buffer_size(socket_options_.receive_buffer), ec);
+      if (ec) LOG_WARNING << transport() << " receive buffer size: " << ec.message();
+   }
+   if (socket_options_.keep_alive > 0) {
+      socket.set_option(net::socket_base::keep_alive(true), ec);
+      if (ec) LOG_WARNING << transport() << " keepalive: " << ec.message();
+#if defined(TCP_KEEPIDLE) && defined(TCP_KEEPINTVL) && defined(TCP_KEEPCNT)
+      // probe after keep_alive idle seconds, give up after 3 unanswered
+      // probes a third of that apart
+      int idle = socket_options_.keep_alive;
+      int interval = std::max(idle / 3, 1);
+      int count = 3;
+      int fd = socket.native_handle();
+      if (setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle)) != 0 ||
+          setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval)) != 0 ||
+          setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count)) != 0)
+         LOG_WARNING << transport() << " keepalive timing: " << strerror(errno);
+#endif
+   }
+   if ( verbose_ ) {
+      net::socket_base::send_buffer_size send;
+      net::socket_base::receive_buffer_size receive;
+      socket.get_option(send, ec);
+      socket.get_option(receive, ec);
+      LOG_DEBUG << transport() << " socket buffers: send " << send.value() << ", receive " << receive.value()
+                << " bytes, nodelay " << socket_options_.no_delay << ", keepalive " << socket_options_.keep_alive << " s";
+   }
+}
+
+// the transport is ready for messages
+void ros_session::opened(std::string response)
+{
+   if (handshakeCallback) handshakeCallback(std::move(response));
+}
+
+// register a coalescing key (topic or signal name) and return its id.
+// Call during setup, before messages are written with the key.
+int ros_session::coalesce_key(const std::string& key)
+{
+   std::lock_guard<std::mutex> lock(keys_mutex);
+   for (std::size_t i = 0; i < keys_.size(); ++i)
+      if (keys_[i] == key) return (int)i;
+   if (keys_.size() >= (std::size_t)max_keys) {
+      LOG_ERROR << transport() << " too many coalescing keys, not coalescing " << key;
+      return -1;
+   }
+   keys_.push_back(key);
+   return (int)keys_.size() - 1;
+}
+
+// may be called from any thread. The message is shared with the queue and
+// the queue is drained by write_next() on the session strand.
+void ros_session::do_write(shared_message message) {
+   if (closing_) return;
+   outbound item;
+   item.message = std::move(message);
+   if (!enqueue(std::move(item))) return;
+
+   // start the write loop unless it is already running
+   if (!write_scheduled.exchange(true)) {
+      net::post(
+         strand_,
+         beast::bind_front_handler(
+               &ros_session::write_next,
+               shared_from_this()));
+   }
+}
+
+// write a message that supersedes any unsent message with the same key.
+// Only the latest message per key is kept while the link is slow.
+void ros_session::do_write(shared_message message, int key) {
+   if (key < 0) return do_write(std::move(message));
+   if (closing_) return;
+
+   shared_message mine = message;
+   shared_message stale = std::atomic_exchange(&pending_[key], std::move(message));
+   if (stale) {
+      // the key is already queued and will pick up the new message
+      coalesced_++;
+      return;
+   }
+
+   for (;;) {
+      outbound item;
+      item.key = key;
+      item.message = mine;
+      if (enqueue(std::move(item))) break;
+      // nothing queued for the key: take the message back, unless another
+      // producer replaced it meanwhile. That newer message counted on the
+      // queue entry, so try again for it.
+      if (std::atomic_compare_exchange_strong(&pending_[key], &mine, shared_message())) return;
+   }
+
+   if (!write_scheduled.exchange(true)) {
+      net::post(
+         strand_,
+         beast::bind_front_handler(
+               &ros_session::write_next,
+               shared_from_this()));
+   }
+}
+
+bool ros_session::enqueue(outbound&& item) {
+   if (message_queue.try_push(std::move(item))) return true;
+
+   queue_policy policy = policy_;
+   // blocking on an I/O thread would stall the writer that makes room, and
+   // every other session and endpoint with it
+   if (policy == queue_policy::block && strand_.get_inner_executor().running_in_this_thread())
+      policy = queue_policy::drop_newest;
+
+   switch (policy) {
+      case queue_policy::drop_oldest : {
+         // an entry whose key was written again since it was queued stands
+         // for that newer message; it goes back in behind instead
+         outbound oldest, requeue;
+         bool requeued = false;
+         for (;;) {
+            if (message_queue.try_push(std::move(item))) {
+               if (!requeued) break;
+               item = std::move(requeue);
+               requeued = false;
+               continue;
+            }
+            if (!message_queue.try_pop(oldest)) continue;
+            if (discard(oldest)) {
+               dropped_oldest_++;
+            } else if (!requeued) {
+               oldest.message = std::atomic_load(&pending_[oldest.key]);
+               requeue = std::move(oldest);
+               requeued = true;
+            } else {
+               // a second rewritten entry while one waits for room: drop it
+               std::atomic_exchange(&pending_[oldest.key], shared_message());
+               dropped_oldest_++;
+            }
+         }
+         if ( verbose_ )
+            LOG_DEBUG << transport() << " queue full, oldest message dropped. Dropped: " << dropped_oldest_;
+         return true;
+      }
+
+      case queue_policy::block : {
+         // sleep until write_next() makes room, but give up if the link is
+         // not draining or the session closes
+         auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+         bool pushed = false;
+         std::unique_lock<std::mutex> lock(room_mutex_);
+         blocked_++;
+         std::atomic_thread_fence(std::memory_order_seq_cst);
+         room_.wait_until(lock, deadline, [&]() {
+            if (closing_) return true;
+            pushed = message_queue.try_push(std::move(item));
+            return pushed;
+         });
+         blocked_--;
+         if (pushed) return true;
+      }
+      // fall through
+
+      case queue_policy::drop_newest :
+         dropped_newest_++;
+         if ( verbose_ )
+            LOG_DEBUG << transport() << " queue full, message dropped. Dropped: " << dropped_newest_;
+         return false;
+   }
+   return false;
+}
+
+// release a queue entry without sending it. Returns false, and leaves the
+// entry as it is, if its key was written again since it was queued.
+bool ros_session::discard(outbound& item) {
+   if (item.key >= 0 &&
+       !std::atomic_compare_exchange_strong(&pending_[item.key], &item.message, shared_message()))
+      return false;
+   item.message.reset();
+   return true;
+}
+
+void ros_session::write_next() {
+   outbound next;
+   for (;;) {
+      // a fragmented message takes turns with the queued messages
+      if (!fragmented_.empty() && fragment_turn_)
+         return write_fragment();
+      if (!message_queue.try_pop(next)) {
+         if (!fragmented_.empty())
+            return write_fragment();
+         write_scheduled = false;
+         // a producer may have queued a message after the pop failed
+         // but before the flag was cleared; keep draining in that case.
+         if (message_queue.empty() || write_scheduled.exchange(true)) {
+            if (closing_ && !write_scheduled) start_close();
+            return;
+         }
+         continue;
+      }
+      // a producer blocked on the full queue can take the slot. The fence
+      // orders the pop before reading blocked_, against the producer that
+      // counts itself before trying the queue.
+      if (policy_ == queue_policy::block) {
+         std::atomic_thread_fence(std::memory_order_seq_cst);
+         if (blocked_) {
+            std::lock_guard<std::mutex> lock(room_mutex_);
+            room_.notify_one();
+         }
+      }
+      // take the latest message for the key. It may be gone if a
+      // producer dropped it after the queue entry was made.
+      shared_message message = next.key < 0 ? std::move(next.message)
+                              : std::atomic_exchange(&pending_[next.key], shared_message());
+      if (!message || fragment(message)) continue;
+      write_message = std::move(message);
+      break;
+   }
+
+   // Send the message
+   fragment_turn_ = true;
+   if (tracer_) write_started_ = latency_tracer::now();
+   write(net::buffer(write_message->data));
+}
+
+void ros_session::on_write(
+      error_code ec,
+      std::size_t bytes_transferred) {
+
+   boost::ignore_unused(bytes_transferred);
+   if(ec) {
+      write_scheduled = false;
+      return fail(ec, "write");
+   }
+   written_++;
+   written_bytes_ += bytes_transferred;
+   if (tracer_ && write_message)
+      tracer_->record(write_message->trace, write_started_, latency_tracer::now(), bytes_transferred);
+   // let the message go back to the pool now, not when the next one is sent
+   write_message.reset();
+   if ( verbose_ )
+      LOG_DEBUG << transport() << " message written: " << bytes_transferred << "bytes. queue size: " << message_queue.size();
+
+   write_next();
+}
+
+// queue message to be sent in fragments if it is too large. Returns false
+// if it is sent as it is.
+bool ros_session::fragment(shared_message& message) {
+   if (fragment_size_ == 0 || binary_ || message->data.size() <= fragment_size_) return false;
+   if (fragmented_.size() >= max_fragmented) {
+      dropped_newest_++;
+      if ( verbose_ )
+         LOG_DEBUG << transport() << " fragment queue full, message dropped. Dropped: " << dropped_newest_;
+   } else {
+      fragmented_.push_back(std::move(message));
+   }
+   message.reset();
+   return true;
+}
+
+// end of the fragment starting at offset. Fragments are text, so a UTF-8
+// sequence is never split.
+std::size_t ros_session::fragment_end(const std::string& data, std::size_t offset) const {
+   std::size_t end = std::min(offset + fragment_size_, data.size());
+   while (end < data.size() && end > offset + 1 && (data[end] & 0xC0) == 0x80) --end;
+   return end;
+}
+
+// write the next fragment of the front fragmented message
+void ros_session::write_fragment() {
+   const std::string& data = fragmented_.front()->data;
+   if (fragment_num_ == 0) {
+      fragment_offset_ = 0;
+      fragment_total_ = 0;
+      for (std::size_t offset = 0; offset < data.size(); offset = fragment_end(data, offset))
+         ++fragment_total_;
+      ++fragment_id_;
+   }
+
+   std::size_t end = fragment_end(data, fragment_offset_);
+   // ids only need to be unique per connection; short ones stay in place
+   std::string id = std::to_string(fragment_id_);
+   fragment_buffer_.clear();
+   ros::fragment_op op{id, {data.data() + fragment_offset_, end - fragment_offset_}, fragment_num_, fragment_total_};
+   ros::serialize(message_template::encoding::json, op, fragment_buffer_);
+   fragment_offset_ = end;
+   fragment_turn_ = false;
+
+   // the message is traced once its last fragment is written
+   if (++fragment_num_ == fragment_total_) {
+      write_message = std::move(fragmented_.front());
+      fragmented_.pop_front();
+      fragment_num_ = 0;
+      fragmented_count_++;
+   } else {
+      write_message.reset();
+   }
+
+   if (tracer_) write_started_ = latency_tracer::now();
+   write(net::buffer(fragment_buffer_));
+}
+
+void ros_session::registerHandshakeCallback(std::function<void(std::string)> cb)
+{
+   handshakeCallback = std::bind(cb, std::placeholders::_1);
+}
+
+// called once when the session ends, after a failure or a close
+void ros_session::registerCloseCallback(std::function<void()> cb)
+{
+   closeCallback = std::move(cb);
+}
+
+// The read callback receives a view into the receive buffer and whether the
+// message came in a binary frame. The view is only valid during the call,
+// it is writable and it is followed by a null terminator so the message can
+// be parsed in place.
+void ros_session::registerReadCallback(std::function<void(net::mutable_buffer, bool)> cb)
+{
+   readCallback = std::move(cb);
+}
+
+// may be called from any thread. Messages queued before the call (e.g.
+// unadvertise ops) are still sent, later ones are dropped. The connection
+// is closed once the queue is drained, or cut after a second if it does
+// not drain.
+void ros_session::do_close()
+{
+   closing_ = true;
+   {
+      // producers blocked on a full queue give up
+      std::lock_guard<std::mutex> lock(room_mutex_);
+      room_.notify_all();
+   }
+   net::post(strand_, [self = shared_from_this()]() {
+      if (!self->is_open()) {
+         // still resolving or connecting
+         self->resolver_.cancel();
+         self->cancel();
+         return;
+      }
+      self->close_timer_.expires_after(std::chrono::seconds(1));
+      self->close_timer_.async_wait([self](error_code ec) {
+         if (ec || self->close_started_) return;
+         LOG_WARNING << self->transport() << " queue not drained, closing";
+         self->cancel();
+      });
+      if (!self->write_scheduled) self->start_close();
+   });
+}
+
+// on the strand, with no write in flight
+void ros_session::start_close()
+{
+   if (close_started_) return;
+   close_started_ = true;
+   close_timer_.cancel();
+
+   LOG_INFO << transport() << " closing";
+   shutdown();
+}
+
+void ros_session::on_close(error_code ec)
+{
+   if(ec) return fail(ec, "close");
+
+   // If we get here then the connection is closed gracefully
+   LOG_INFO << transport() << " closed gracefully";
+   closed();
+}
+
+void ros_session::set_verbose(bool flag) {
+   verbose_ = flag;
+}
+
+void ros_session::set_queue_policy(queue_policy policy) {
+   policy_ = policy;
+}
+
+// send binary messages (CBOR) instead of text. Call before run().
+void ros_session::set_binary(bool flag) {
+   binary_ = flag;
+}
+
+
+// send text messages larger than size as rosbridge fragment ops, 0 to
+// send every message whole. Binary (CBOR) messages are never fragmented.
+// Call before run().
+void ros_session::set_fragment_size(std::size_t size) {
+   fragment_size_ = size;
+}
+
+// TCP options applied once connected. Call before run().
+void ros_session::set_socket_options(const socket_options& options) {
+   socket_options_ = options;
+}
+
+// record the latency of every written message. The tracer must be used by
+// sessions of one io_context thread only.
+void ros_session::set_tracer(latency_tracer* tracer) {
+   tracer_ = tracer;
+}
+
+queue_stats ros_session::stats() const {
+   queue_stats stats;
+   stats.depth = message_queue.size();
+   stats.capacity = message_queue.capacity();
+   stats.coalesced = coalesced_;
+   stats.dropped_oldest = dropped_oldest_;
+   stats.dropped_newest = dropped_newest_;
+   stats.fragmented = fragmented_count_;
+   stats.written = written_;
+   stats.written_bytes = written_bytes_;
+   return stats;
+}
@@ -0,0 +1,203 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#pragma once
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <iostream>
+#include <functional>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <stdbool.h>
+
+#include <boost/asio.hpp>
+
+namespace net = boost::asio;                    // namespace asio
+using tcp = net::ip::tcp;                       // from <boost/asio/ip/tcp.hpp>
+using error_code = boost::system::error_code;   // from <boost/system/error_code.hpp>
+
+#include <boost/beast.hpp>
+
+namespace beast = boost::beast;
+namespace http = boost::beast::http;            // from <boost/beast/http.hpp>
+namespace websocket = boost::beast::websocket;  // from <boost/beast/websocket.hpp>
+
+#include "bounded_queue.hpp"
+#include "latency_tracer.hpp"
+
+/**
+ * @brief Serialized message and its trace
+ */
+struct outbound_message {
+   std::string data;
+   message_trace trace;
+};
+
+/**
+ * @brief Message shared by the queues of all sessions it is written to.
+ * It is never modified once queued.
+ */
+typedef std::shared_ptr<const outbound_message> shared_message;
+
+/**
+ * @brief What do_write() does when the outbound queue is full
+ */
+enum class queue_policy {
+   drop_oldest,   // discard the oldest queued message to make room
+   drop_newest,   // discard the message being written
+   block          // wait for room (never on an I/O thread: drops newest there)
+};
+
+/**
+ * @brief Outbound queue counters of a session
+ */
+struct queue_stats {
+   std::size_t depth;
+   std::size_t capacity;
+   std::size_t coalesced;        // replaced by a newer message with the same key
+   std::size_t dropped_oldest;
+   std::size_t dropped_newest;
+   std::size_t fragmented;       // sent as rosbridge fragments
+   std::size_t written;          // messages written, fragments counted each
+   std::size_t written_bytes;
+};
+
+/**
+ * @brief Options of the TCP socket of a session, applied once it is connected
+ */
+struct socket_options {
+   bool no_delay = true;      // TCP_NODELAY, send small messages without waiting for more
+   int send_buffer = 0;       // SO_SNDBUF bytes, 0: system default
+   int receive_buffer = 0;    // SO_RCVBUF bytes, 0: system default
+   int keep_alive = 0;        // seconds idle before keepalive probes are sent, 0: off
+};
+
+/**
+ * @brief Ros_Session Class is a client connection to a rosbridge server,
+ * the part common to all transports.
+ *
+ * It resolves the server, keeps the outbound queue with its coalescing
+ * keys and drop policy, sends large messages as rosbridge fragments and
+ * closes once the queue is drained. Messages are written one at a time on
+ * the session strand. Transports derive from it, connect, write single
+ * messages, read and close their stream.
+ */
+class ros_session : public std::enable_shared_from_this<ros_session>
+{
+public:
+   virtual ~ros_session();
+
+   void run(std::string host, std::string port, std::string target);
+   void registerReadCallback(std::function<void(net::mutable_buffer, bool)> cb);
+   void registerHandshakeCallback(std::function<void(std::string)> cb);
+   void registerCloseCallback(std::function<void()> cb);
+   int coalesce_key(const std::string& key);
+   void do_write(shared_message message);
+   void do_write(shared_message message, int key);
+   void do_close();
+   void set_verbose(bool flag);
+   void set_queue_policy(queue_policy policy);
+   void set_binary(bool flag);
+   void set_fragment_size(std::size_t size);
+   void set_tracer(latency_tracer* tracer);
+   void set_socket_options(const socket_options& options);
+   queue_stats stats() const;
+
+protected:
+   ros_session(net::io_context& ioc, std::size_t queue_size);
+
+   net::strand<net::io_context::executor_type> strand_;
+   std::string host_;
+   std::string target_;
+   std::function<void(net::mutable_buffer, bool)> readCallback;
+   bool binary_ = false;
+   bool verbose_ = false;
+
+   // name of the transport in log messages
+   virtual const char* transport() const = 0;
+   // connect and handshake, then call opened()
+   virtual void connect(const tcp::resolver::results_type& results) = 0;
+   // write one message, then call on_write()
+   virtual void write(net::const_buffer data) = 0;
+   virtual bool is_open() const = 0;
+   // abort the connection attempt or the operations in flight
+   virtual void cancel() = 0;
+   // close the connection, then call on_close()
+   virtual void shutdown() = 0;
+
+   void apply_socket_options(tcp::socket& socket);
+   void opened(std::string response);
+   void on_write(error_code ec, std::size_t bytes_transferred);
+   void on_close(error_code ec);
+   void fail(error_code ec, char const* what);
+   void closed();
+   bool closing() const { return closing_; }
+
+private:
+   // queued message. Keyed messages are held in pending_[key] and the
+   // queue entry marks the key as ready to be sent; it keeps the message
+   // it was queued with, to tell whether the key was written again since.
+   struct outbound {
+      shared_message message;
+      int key = -1;
+   };
+
+   tcp::resolver resolver_;
+   net::steady_timer close_timer_;
+   std::function<void(std::string)> handshakeCallback;
+   std::function<void()> closeCallback;
+   bool closed_ = false;
+   std::atomic<bool> closing_{false};   // do_close() called, no more writes
+   bool close_started_ = false;
+   bounded_queue<outbound> message_queue;
+   std::atomic<bool> write_scheduled{false};
+   // producers waiting for room under queue_policy::block, woken by write_next()
+   std::atomic<int> blocked_{0};
+   std::mutex room_mutex_;
+   std::condition_variable room_;
+   shared_message write_message;    // message referenced by the write in flight
+   int64_t write_started_ = 0;
+   latency_tracer* tracer_ = nullptr;
+   queue_policy policy_ = queue_policy::drop_oldest;
+   socket_options socket_options_;
+
+   static const int max_keys = 256;
+   // latest unsent message per coalescing key, accessed with std::atomic_exchange
+   std::unique_ptr<shared_message[]> pending_;
+   std::vector<std::string> keys_;
+   mutable std::mutex keys_mutex;
+
+   std::atomic<std::size_t> coalesced_{0};
+   std::atomic<std::size_t> dropped_oldest_{0};
+   std::atomic<std::size_t> dropped_newest_{0};
+   std::atomic<std::size_t> written_{0};
+   std::atomic<std::size_t> written_bytes_{0};
+
+   // text messages larger than fragment_size_ are sent as rosbridge
+   // fragment ops, taking turns with the queued messages, so a large
+   // message does not hold back the small ones behind it
+   static const std::size_t max_fragmented = 16;
+   std::size_t fragment_size_ = 0;
+   std::deque<shared_message> fragmented_;   // front is being sent
+   std::size_t fragment_offset_ = 0;
+   int fragment_num_ = 0;
+   int fragment_total_ = 0;
+   uint64_t fragment_id_ = 0;
+   bool fragment_turn_ = false;
+   std::string fragment_buffer_;             // fragment op being written
+   std::atomic<std::size_t> fragmented_count_{0};
+
+   void on_resolve(error_code ec, tcp::resolver::results_type results);
+   bool enqueue(outbound&& item);
+   bool discard(outbound& item);
+   void write_next();
+   bool fragment(shared_message& message);
+   std::size_t fragment_end(const std::string& data, std::size_t offset) const;
+   void write_fragment();
+   void start_close();
+};
@@ -0,0 +1,187 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#include "service_caller.hpp"
+
+// request ids of the bridge, so responses to other clients' calls that
+// reach us are never mistaken for ours
+const char service_caller::id_prefix[] = "amm_bridge:";
+
+namespace {
+   const rapidjson::Value noValues;
+}
+
+const char* service_status_name(service_status status)
+{
+   switch (status) {
+      case service_status::succeeded : return "succeeded";
+      case service_status::failed : return "failed";
+      case service_status::timed_out : return "timed out";
+      case service_status::cancelled : return "cancelled";
+   }
+   return "unknown";
+}
+
+service_caller::service_caller(boost::asio::io_context& ioc, ros_fanout& fanout, std::size_t limit)
+   : ioc_(ioc)
+   , fanout_(fanout)
+   , timer_(ioc)
+   , armed_(clock::time_point::max())
+{
+   set_limit(limit);
+}
+
+void service_caller::set_limit(std::size_t limit)
+{
+   // without a limit, no call ever waits for a place
+   limit_ = limit > 0 ? limit : std::numeric_limits<std::size_t>::max();
+   if (limit > 0) in_flight_.reserve(limit);
+}
+
+bool service_caller::parse_id(const message_peek::field& id, uint64_t& n)
+{
+   const std::size_t prefix = sizeof(id_prefix) - 1;
+   if (!id.present || id.length <= prefix || std::memcmp(id.data(), id_prefix, prefix) != 0) return false;
+   char* end = nullptr;
+   n = std::strtoull(id.data() + prefix, &end, 10);
+   return end == id.data() + id.length;
+}
+
+bool service_caller::expects(const message_peek::field& id) const
+{
+   uint64_t n;
+   if (!parse_id(id, n)) return false;
+   for (const request& r : in_flight_)
+      if (r.id == n) return true;
+   return false;
+}
+
+void service_caller::submit(request r)
+{
+   waiting_.push_back(std::move(r));
+   send_waiting();
+   arm();
+}
+
+// send waiting calls in order while there is room
+void service_caller::send_waiting()
+{
+   while (in_flight_.size() < limit_ && !waiting_.empty()) {
+      request r = std::move(waiting_.front());
+      waiting_.pop_front();
+      if (send(r))
+         in_flight_.push_back(std::move(r));
+      else
+         finish(r, service_status::failed, noValues);
+   }
+}
+
+bool service_caller::send(request& r)
+{
+   ros_endpoint* endpoint = r.endpoint && r.endpoint->connected() ? r.endpoint : nullptr;
+   for (const auto& e : fanout_.endpoints()) {
+      if (endpoint) break;
+      if (e->connected()) endpoint = e.get();
+   }
+   if (!endpoint) return false;
+   endpoint->write(r.message);
+   // the session holds the message until it is written
+   r.message.reset();
+   return true;
+}
+
+// r is no longer in_flight_ or waiting_, done may call into the caller
+void service_caller::finish(request& r, service_status status, const rapidjson::Value& values)
+{
+   switch (status) {
+      case service_status::succeeded : ++succeeded_; break;
+      case service_status::failed : ++failed_; break;
+      case service_status::timed_out : ++timed_out_; break;
+      case service_status::cancelled : break;
+   }
+   if (r.done) r.done(status, values);
+}
+
+// {"op":"service_response","id":..,"service":..,"values":{..},"result":true}
+bool service_caller::complete(const message_peek::field& id, const rapidjson::Value& response)
+{
+   uint64_t n;
+   if (!parse_id(id, n)) return false;
+   for (std::size_t i = 0; i < in_flight_.size(); ++i) {
+      if (in_flight_[i].id != n) continue;
+      request r = std::move(in_flight_[i]);
+      if (i + 1 < in_flight_.size()) in_flight_[i] = std::move(in_flight_.back());
+      in_flight_.pop_back();
+
+      // rosbridge versions without "result" only answer calls that succeeded
+      bool succeeded = true;
+      const rapidjson::Value* values = &noValues;
+      if (response.IsObject()) {
+         auto result = response.FindMember("result");
+         if (result != response.MemberEnd() && result->value.IsBool()) succeeded = result->value.GetBool();
+         auto v = response.FindMember("values");
+         if (v != response.MemberEnd()) values = &v->value;
+      }
+      finish(r, succeeded ? service_status::succeeded : service_status::failed, *values);
+
+      send_waiting();
+      arm();
+      return true;
+   }
+   return false;
+}
+
+void service_caller::cancel_all()
+{
+   std::vector<request> inFlight;
+   std::deque<request> waiting;
+   inFlight.swap(in_flight_);
+   waiting.swap(waiting_);
+   timer_.cancel();
+   armed_ = clock::time_point::max();
+   for (request& r : inFlight) finish(r, service_status::cancelled, noValues);
+   for (request& r : waiting) finish(r, service_status::cancelled, noValues);
+}
+
+// one timer for all calls, waiting for the earliest deadline. It is only
+// moved when a call with an earlier deadline comes in; when the call it
+// waits for completes first, it fires early and waits again.
+void service_caller::arm()
+{
+   clock::time_point earliest = clock::time_point::max();
+   for (const request& r : in_flight_) earliest = std::min(earliest, r.deadline);
+   for (const request& r : waiting_) earliest = std::min(earliest, r.deadline);
+   if (earliest == clock::time_point::max() || earliest >= armed_) return;
+
+   armed_ = earliest;
+   timer_.expires_at(earliest);
+   timer_.async_wait([this](const boost::system::error_code& ec) { on_timer(ec); });
+}
+
+void service_caller::on_timer(const boost::system::error_code& ec)
+{
+   if (ec == boost::asio::error::operation_aborted) return;
+   armed_ = clock::time_point::max();
+
+   clock::time_point now = clock::now();
+   for (std::size_t i = 0; i < in_flight_.size();) {
+      if (in_flight_[i].deadline > now) { ++i; continue; }
+      request r = std::move(in_flight_[i]);
+      if (i + 1 < in_flight_.size()) in_flight_[i] = std::move(in_flight_.back());
+      in_flight_.pop_back();
+      finish(r, service_status::timed_out, noValues);
+   }
+   for (std::size_t i = 0; i < waiting_.size();) {
+      if (waiting_[i].deadline > now) { ++i; continue; }
+      request r = std::move(waiting_[i]);
+      waiting_.erase(waiting_.begin() + i);
+      finish(r, service_status::timed_out, noValues);
+   }
+
+   send_waiting();
+   arm();
+}
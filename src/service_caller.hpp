@@ -0,0 +1,142 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "rapidjson/document.h"
+
+#include "message_router.hpp"
+#include "message_template.hpp"
+#include "ros_endpoint.hpp"
+#include "ros_messages.hpp"
+
+/**
+ * @brief How a service call ended
+ */
+enum class service_status {
+   succeeded,   // service_response with result true
+   failed,      // service_response with result false, or no ROS instance connected
+   timed_out,   // no response before the deadline
+   cancelled    // cancel_all() at shutdown
+};
+
+const char* service_status_name(service_status status);
+
+/**
+ * @brief Service_Caller sends rosbridge call_service ops and matches the
+ * service_response ops to them by request id.
+ *
+ * Calls are pipelined: up to limit calls (any number if 0) are in flight
+ * at once, each waiting for its own response, so a slow service does not
+ * hold back the calls behind it. Further calls wait in order until a
+ * response or a timeout frees a place. The deadline of a call counts from
+ * call(), time spent waiting included.
+ *
+ * A call is sent to the endpoint given, or to the first connected one.
+ * When the connection is lost before the response, the call times out.
+ *
+ * call() may be called from any thread. Everything else, completions
+ * included, runs on the io_context.
+ */
+class service_caller
+{
+public:
+   // values: the "values" of the response, which rosbridge fills with the
+   // error message when a call fails. Null without a response.
+   typedef std::function<void(service_status status, const rapidjson::Value& values)> completion;
+
+   service_caller(boost::asio::io_context& ioc, ros_fanout& fanout, std::size_t limit = 16);
+
+   // encoding of the call_service ops. Call before the first call().
+   void set_encoding(message_template::encoding enc) { enc_ = enc; }
+   // calls in flight at once, 0 for no limit
+   void set_limit(std::size_t limit);
+
+   // call service with args, any message struct of ros_messages.hpp
+   template <typename Args>
+   void call(const std::string& service, const std::string& type, const Args& args,
+             std::chrono::milliseconds timeout, completion done, ros_endpoint* endpoint = nullptr);
+
+   // the response belongs to a call in flight
+   bool expects(const message_peek::field& id) const;
+   // resolve the call of a service_response. Returns false if no call is
+   // waiting for it, e.g. because it timed out.
+   bool complete(const message_peek::field& id, const rapidjson::Value& response);
+   // fail all calls, e.g. before the connections close
+   void cancel_all();
+
+   std::size_t in_flight() const { return in_flight_.size(); }
+   std::size_t waiting() const { return waiting_.size(); }
+   std::size_t succeeded() const { return succeeded_; }
+   std::size_t failed() const { return failed_; }
+   std::size_t timed_out() const { return timed_out_; }
+
+private:
+   typedef std::chrono::steady_clock clock;
+
+   struct request {
+      uint64_t id = 0;
+      std::string service;
+      shared_message message;
+      clock::time_point deadline;
+      completion done;
+      ros_endpoint* endpoint = nullptr;
+   };
+
+   boost::asio::io_context& ioc_;
+   ros_fanout& fanout_;
+   message_template::encoding enc_ = message_template::encoding::json;
+   std::size_t limit_;
+   std::atomic<uint64_t> next_id_{1};
+
+   std::vector<request> in_flight_;   // few calls: scanned, not hashed
+   std::deque<request> waiting_;
+   boost::asio::steady_timer timer_;
+   clock::time_point armed_;          // deadline the timer waits for, max() if idle
+
+   std::size_t succeeded_ = 0;
+   std::size_t failed_ = 0;
+   std::size_t timed_out_ = 0;
+
+   static const char id_prefix[];
+
+   static bool parse_id(const message_peek::field& id, uint64_t& n);
+   void submit(request r);
+   void send_waiting();
+   bool send(request& r);
+   void finish(request& r, service_status status, const rapidjson::Value& values);
+   void arm();
+   void on_timer(const boost::system::error_code& ec);
+};
+
+template <typename Args>
+void service_caller::call(const std::string& service, const std::string& type, const Args& args,
+                          std::chrono::milliseconds timeout, completion done, ros_endpoint* endpoint)
+{
+   request r;
+   r.id = next_id_++;
+   r.service = service;
+   r.deadline = clock::now() + timeout;
+   r.done = std::move(done);
+   r.endpoint = endpoint;
+
+   // serialized here, on the calling thread, into a pooled message
+   std::string id = id_prefix + std::to_string(r.id);
+   std::shared_ptr<outbound_message> message = fanout_.acquire();
+   ros::call_service_op<const Args&> op{id, service, args, ros::unless_empty(type)};
+   ros::serialize(enc_, op, message->data);
+   r.message = std::move(message);
+
+   boost::asio::post(ioc_, [this, r = std::move(r)]() mutable { submit(std::move(r)); });
+}
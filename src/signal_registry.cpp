@@ -0,0 +1,123 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#include <cmath>
+#include <limits>
+
+#include "signal_registry.hpp"
+
+namespace {
+   const std::string empty_string;
+   const double no_value = std::numeric_limits<double>::quiet_NaN();
+}
+
+bool signal_registry::sample::valid() const
+{
+   return !std::isnan(value);
+}
+
+signal_registry::signal_registry(std::size_t capacity)
+   : capacity_(capacity)
+   , slots_(new slot[capacity])
+   , units_(new std::string[capacity])
+{
+   names_.reserve(capacity);
+   for (std::size_t i = 0; i < capacity; ++i) {
+      slots_[i].seq.store(0, std::memory_order_relaxed);
+      slots_[i].value.store(no_value, std::memory_order_relaxed);
+      slots_[i].timestamp.store(0, std::memory_order_relaxed);
+      slots_[i].source.store(0, std::memory_order_relaxed);
+      slots_[i].has_unit.store(false, std::memory_order_relaxed);
+   }
+}
+
+signal_registry::signal_id signal_registry::intern(const std::string& name)
+{
+   auto it = index_.find(name);
+   if (it != index_.end()) return it->second;
+   if (names_.size() >= capacity_) return invalid_id;
+
+   signal_id id = (signal_id)names_.size();
+   names_.push_back(name);
+   index_.emplace(name, id);
+   return id;
+}
+
+signal_registry::signal_id signal_registry::find(const std::string& name) const
+{
+   auto it = index_.find(name);
+   return it == index_.end() ? invalid_id : it->second;
+}
+
+std::size_t signal_registry::size() const
+{
+   return names_.size();
+}
+
+const std::string& signal_registry::name(signal_id id) const
+{
+   return names_[id];
+}
+
+void signal_registry::set_unit(signal_id id, const std::string& unit)
+{
+   slot& s = slots_[id];
+   if (s.has_unit.load(std::memory_order_acquire)) return;
+   units_[id] = unit;
+   s.has_unit.store(true, std::memory_order_release);
+}
+
+const std::string& signal_registry::unit(signal_id id) const
+{
+   if (!slots_[id].has_unit.load(std::memory_order_acquire)) return empty_string;
+   return units_[id];
+}
+
+void signal_registry::write(slot& s, double value, int64_t timestamp, int64_t source)
+{
+   // take the slot by making the sequence odd. Concurrent writers are rare
+   // (a reset racing the DDS callback) and only spin for the few stores below.
+   uint64_t seq = s.seq.load(std::memory_order_relaxed);
+   for (;;) {
+      if (seq & 1) {
+         seq = s.seq.load(std::memory_order_relaxed);
+         continue;
+      }
+      if (s.seq.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire, std::memory_order_relaxed))
+         break;
+   }
+   std::atomic_thread_fence(std::memory_order_release);
+   s.value.store(value, std::memory_order_relaxed);
+   s.timestamp.store(timestamp, std::memory_order_relaxed);
+   s.source.store(source, std::memory_order_relaxed);
+   s.seq.store(seq + 2, std::memory_order_release);
+}
+
+void signal_registry::store(signal_id id, double value, int64_t timestamp, int64_t source)
+{
+   write(slots_[id], value, timestamp, source);
+}
+
+signal_registry::sample signal_registry::load(signal_id id) const
+{
+   const slot& s = slots_[id];
+   sample out;
+   for (;;) {
+      uint64_t before = s.seq.load(std::memory_order_acquire);
+      if (before & 1) continue;
+      out.value = s.value.load(std::memory_order_relaxed);
+      out.timestamp = s.timestamp.load(std::memory_order_relaxed);
+      out.source = s.source.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (s.seq.load(std::memory_order_relaxed) == before) {
+         out.seq = before / 2;
+         return out;
+      }
+   }
+}
+
+void signal_registry::reset()
+{
+   for (std::size_t i = 0; i < names_.size(); ++i)
+      write(slots_[i], no_value, 0, 0);
+}
@@ -0,0 +1,74 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Signal_Registry holds the latest value of every physiology signal
+ * the bridge forwards.
+ *
+ * Signal names are interned to dense integer ids when the subscriptions are
+ * set up, before any data arrives. After that the name table is read only,
+ * and values, timestamps and update counts live in one contiguous array of
+ * slots. Each slot is guarded by a sequence lock: writers never wait for
+ * readers, and readers retry if a write was in progress, so DDS callbacks
+ * and the serializer can use the registry from different threads without a
+ * mutex.
+ */
+class signal_registry
+{
+public:
+   typedef int signal_id;
+   static const signal_id invalid_id = -1;
+
+   struct sample {
+      double value;        // NaN until a value was stored
+      int64_t timestamp;   // steady clock nanoseconds at reception
+      int64_t source;      // steady clock nanoseconds when it was published, 0 if unknown
+      uint64_t seq;        // number of stores since startup
+      bool valid() const;
+   };
+
+   explicit signal_registry(std::size_t capacity = 256);
+
+   // setup time only: not safe while other threads call find()
+   signal_id intern(const std::string& name);
+
+   signal_id find(const std::string& name) const;
+   std::size_t size() const;
+   const std::string& name(signal_id id) const;
+
+   // the unit is taken from the first sample and never changes afterwards
+   void set_unit(signal_id id, const std::string& unit);
+   const std::string& unit(signal_id id) const;
+
+   void store(signal_id id, double value, int64_t timestamp, int64_t source = 0);
+   sample load(signal_id id) const;
+
+   // invalidate all values, e.g. on simulation reset
+   void reset();
+
+private:
+   struct slot {
+      std::atomic<uint64_t> seq;   // odd while a store is in progress
+      std::atomic<double> value;
+      std::atomic<int64_t> timestamp;
+      std::atomic<int64_t> source;
+      std::atomic<bool> has_unit;
+   };
+
+   void write(slot& s, double value, int64_t timestamp, int64_t source);
+
+   std::size_t capacity_;
+   std::unique_ptr<slot[]> slots_;
+   std::vector<std::string> names_;
+   std::unique_ptr<std::string[]> units_;
+   std::unordered_map<std::string, signal_id> index_;
+};
@@ -0,0 +1,86 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+/**
+ * @brief Fixed size single-producer/single-consumer ring buffer.
+ *
+ * Storage is allocated once; push() fails instead of growing when the ring
+ * is full. One thread may push while another pops without locking.
+ */
+template <typename T>
+class spsc_ring
+{
+   std::unique_ptr<T[]> buffer_;
+   std::size_t mask_;
+   char pad0_[64];
+   std::atomic<std::size_t> head_;   // next slot to pop, written by the consumer
+   char pad1_[64];
+   std::atomic<std::size_t> tail_;   // next slot to push, written by the producer
+   char pad2_[64];
+
+public:
+   // capacity is rounded up to the next power of two
+   explicit spsc_ring(std::size_t capacity)
+   {
+      std::size_t size = 2;
+      while (size < capacity) size <<= 1;
+      buffer_.reset(new T[size]);
+      mask_ = size - 1;
+      head_.store(0, std::memory_order_relaxed);
+      tail_.store(0, std::memory_order_relaxed);
+   }
+
+   spsc_ring(const spsc_ring&) = delete;
+   spsc_ring& operator=(const spsc_ring&) = delete;
+
+   bool push(const T& value)
+   {
+      std::size_t tail = tail_.load(std::memory_order_relaxed);
+      if (tail - head_.load(std::memory_order_acquire) > mask_) return false;
+      buffer_[tail & mask_] = value;
+      tail_.store(tail + 1, std::memory_order_release);
+      return true;
+   }
+
+   bool push(T&& value)
+   {
+      std::size_t tail = tail_.load(std::memory_order_relaxed);
+      if (tail - head_.load(std::memory_order_acquire) > mask_) return false;
+      buffer_[tail & mask_] = std::move(value);
+      tail_.store(tail + 1, std::memory_order_release);
+      return true;
+   }
+
+   bool pop(T& value)
+   {
+      std::size_t head = head_.load(std::memory_order_relaxed);
+      if (head == tail_.load(std::memory_order_acquire)) return false;
+      value = std::move(buffer_[head & mask_]);
+      head_.store(head + 1, std::memory_order_release);
+      return true;
+   }
+
+   // oldest element, consumer only. nullptr when empty.
+   const T* front() const
+   {
+      std::size_t head = head_.load(std::memory_order_relaxed);
+      if (head == tail_.load(std::memory_order_acquire)) return nullptr;
+      return &buffer_[head & mask_];
+   }
+
+   std::size_t size() const
+   {
+      return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+   }
+
+   bool empty() const { return size() == 0; }
+
+   std::size_t capacity() const { return mask_ + 1; }
+};
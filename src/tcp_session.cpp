@@ -0,0 +1,103 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#include <chrono>
+
+#include "amm/BaseLogger.h"
+#include "tcp_session.hpp"
+
+tcp_session::tcp_session(net::io_context& ioc, std::size_t queue_size)
+   : ros_session(ioc, queue_size)
+   , stream_(strand_)
+{
+}
+
+std::shared_ptr<tcp_session> tcp_session::self()
+{
+   return std::static_pointer_cast<tcp_session>(shared_from_this());
+}
+
+void tcp_session::connect(const tcp::resolver::results_type& results)
+{
+   stream_.expires_after(std::chrono::seconds(10));
+   stream_.async_connect(
+      results,
+      beast::bind_front_handler(
+         &tcp_session::on_connect,
+         self()));
+}
+
+void tcp_session::on_connect(
+   error_code ec,
+   tcp::resolver::results_type::endpoint_type ep)
+{
+   if(ec) return fail(ec, "connect");
+   LOG_INFO << "tcp connected to " << ep;
+   stream_.expires_never();
+   apply_socket_options(stream_.socket());
+
+   // rosbridge takes messages as soon as the connection is there
+   opened(std::string());
+   read();
+}
+
+// messages are written back to back, rosbridge finds where they end
+void tcp_session::write(net::const_buffer data)
+{
+   net::async_write(stream_, data,
+      [self = self()](error_code ec, std::size_t bytes_transferred) {
+         self->on_write(ec, bytes_transferred);
+      });
+}
+
+void tcp_session::read()
+{
+   stream_.async_read_some(
+      splitter_.prepare(),
+      beast::bind_front_handler(
+         &tcp_session::on_read,
+         self()));
+}
+
+void tcp_session::on_read(
+   error_code ec,
+   std::size_t bytes_transferred)
+{
+   if( ec == net::error::eof ) {
+      LOG_ERROR << "read: end-of-file " << ec.message();
+      return closed();
+   }
+   // the socket was closed by shutdown()
+   if (ec == net::error::operation_aborted && closing()) return;
+   if (ec) return fail(ec, "read");
+
+   bool json = splitter_.commit(bytes_transferred, [this](char* data, std::size_t size) {
+      if (readCallback) readCallback(net::mutable_buffer(data, size), false);
+   });
+   if (!json) {
+      LOG_ERROR << "tcp stream from " << host_ << " is not rosbridge json, closing";
+      error_code ignored;
+      stream_.socket().close(ignored);
+      return closed();
+   }
+   read();
+}
+
+bool tcp_session::is_open() const
+{
+   return stream_.socket().is_open();
+}
+
+void tcp_session::cancel()
+{
+   stream_.cancel();
+}
+
+// called with no write in flight, so everything queued has been sent
+void tcp_session::shutdown()
+{
+   error_code ec;
+   stream_.socket().shutdown(tcp::socket::shutdown_both, ec);
+   stream_.socket().close(ec);
+   on_close(error_code());
+}
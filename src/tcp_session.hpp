@@ -0,0 +1,37 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#pragma once
+
+#include "json_splitter.hpp"
+#include "ros_session.hpp"
+
+/**
+ * @brief Tcp_Session Class speaks the plain TCP protocol of rosbridge
+ * (rosbridge_tcp): json messages written back to back on the socket,
+ * without websocket framing, masking or handshake.
+ *
+ * Messages from the server are cut apart by a json_splitter. There is no
+ * framing for binary messages, so the session is json only.
+ */
+class tcp_session : public ros_session
+{
+   beast::tcp_stream stream_;
+   json_splitter splitter_;
+
+   std::shared_ptr<tcp_session> self();
+   void on_connect(error_code ec, tcp::resolver::results_type::endpoint_type ep);
+   void read();
+   void on_read(error_code ec, std::size_t bytes_transferred);
+
+protected:
+   const char* transport() const override { return "tcp"; }
+   void connect(const tcp::resolver::results_type& results) override;
+   void write(net::const_buffer data) override;
+   bool is_open() const override;
+   void cancel() override;
+   void shutdown() override;
+
+public:
+   explicit tcp_session(net::io_context& ioc, std::size_t queue_size = 1024);
+};
@@ -0,0 +1,64 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#include "waveform_buffer.hpp"
+
+waveform_buffer::waveform_buffer(const std::string& name, std::size_t capacity)
+   : name_(name)
+   , samples_(capacity)
+{
+}
+
+const std::string& waveform_buffer::name() const
+{
+   return name_;
+}
+
+void waveform_buffer::set_unit(const std::string& unit)
+{
+   if (has_unit_.load(std::memory_order_acquire)) return;
+   unit_ = unit;
+   has_unit_.store(true, std::memory_order_release);
+}
+
+const std::string& waveform_buffer::unit() const
+{
+   static const std::string none;
+   return has_unit_.load(std::memory_order_acquire) ? unit_ : none;
+}
+
+void waveform_buffer::push(double value, int64_t timestamp)
+{
+   if (received_.load(std::memory_order_relaxed) == 0)
+      first_timestamp_.store(timestamp, std::memory_order_relaxed);
+   last_timestamp_.store(timestamp, std::memory_order_relaxed);
+   received_.fetch_add(1, std::memory_order_relaxed);
+
+   if (!samples_.push(sample{value, timestamp}))
+      overruns_.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::size_t waveform_buffer::size() const
+{
+   return samples_.size();
+}
+
+int64_t waveform_buffer::oldest() const
+{
+   const sample* s = samples_.front();
+   return s ? s->timestamp : 0;
+}
+
+double waveform_buffer::sample_rate() const
+{
+   // long run average, DDS delivers samples in bursts
+   uint64_t received = received_.load(std::memory_order_relaxed);
+   int64_t span = last_timestamp_.load(std::memory_order_relaxed) - first_timestamp_.load(std::memory_order_relaxed);
+   if (received < 2 || span <= 0) return 0.0;
+   return (received - 1) * 1e9 / span;
+}
+
+std::size_t waveform_buffer::overruns() const
+{
+   return overruns_.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,65 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "spsc_ring.hpp"
+
+/**
+ * @brief Waveform_Buffer accumulates the samples of one high frequency
+ * waveform until they are forwarded to ROS as a chunk.
+ *
+ * Samples are kept in a preallocated ring together with their reception
+ * time. The DDS callback pushes, the chunk writer drains; when the writer
+ * falls behind, new samples are counted as overruns and dropped.
+ */
+class waveform_buffer
+{
+public:
+   struct sample {
+      double value;
+      int64_t timestamp;   // steady clock nanoseconds at reception
+   };
+
+   waveform_buffer(const std::string& name, std::size_t capacity);
+
+   const std::string& name() const;
+   void set_unit(const std::string& unit);
+   const std::string& unit() const;
+
+   // producer side
+   void push(double value, int64_t timestamp);
+
+   // consumer side
+   std::size_t size() const;
+   int64_t oldest() const;       // timestamp of the oldest buffered sample, 0 if empty
+   double sample_rate() const;   // measured average rate in Hz, 0 until known
+   std::size_t overruns() const;
+
+   // hand up to max buffered samples to fn, oldest first
+   template <typename Fn>
+   std::size_t consume(std::size_t max, Fn fn)
+   {
+      std::size_t n = 0;
+      sample s;
+      while (n < max && samples_.pop(s)) {
+         fn(s);
+         ++n;
+      }
+      return n;
+   }
+
+private:
+   std::string name_;
+   std::string unit_;
+   std::atomic<bool> has_unit_{false};
+   spsc_ring<sample> samples_;
+   std::atomic<int64_t> first_timestamp_{0};
+   std::atomic<int64_t> last_timestamp_{0};
+   std::atomic<uint64_t> received_{0};
+   std::atomic<std::size_t> overruns_{0};
+};
@@ -1,232 +1,190 @@
-// Copyright (c) 2025 Rainer Leuschke
-// University of Washington, CREST lab
-
-#include "amm/BaseLogger.h"
-#include "websocket_session.hpp"
-
-websocket_session::websocket_session(net::io_context& ioc)
-   : resolver_(net::make_strand(ioc))
-   , ws_(net::make_strand(ioc))
-{
-}
-
-websocket_session::~websocket_session()
-{
-}
-
-void websocket_session::run(
-   std::string host,
-   std::string port,
-   std::string target)
-{
-   // Save for later
-   host_ = host;
-   target_ = target;
-
-   // Look up the domain name
-   resolver_.async_resolve(
-      host,
-      port,
-      beast::bind_front_handler(
-            &websocket_session::on_resolve,
-            shared_from_this()));
-}
-
-void websocket_session::fail(error_code ec, char const* what)
-{
-   // Do report these
-   if( ec == net::error::operation_aborted ) {
-      LOG_ERROR << what << " operation aborted: " << ec.message();
-      return;
-   }
-   if( ec == websocket::error::closed) {
-      LOG_ERROR << what << " websocket closed: " << ec.message();
-      return;
-   }
-   LOG_ERROR << what << ": " << ec.message();
-}
-
-void websocket_session::on_resolve(
-   error_code ec,
-   tcp::resolver::results_type results)
-{
-   if(ec) return fail(ec, "resolve");
-   for(tcp::endpoint const& endpoint : results) {
-      LOG_INFO << "websocket resolved endpoint: " << endpoint;
-   }
-
-   // Set the timeout for the operation
-   beast::get_lowest_layer(ws_).expires_after(std::chrono::seconds(10));
-
-   // Make the connection on the IP address we get from a lookup
-   beast::get_lowest_layer(ws_).async_connect(
-      results,
-      beast::bind_front_handler(
-         &websocket_session::on_connect,
-         shared_from_this()));
-}
-
-void websocket_session::on_connect(
-   error_code ec,
-   tcp::resolver::results_type::endpoint_type ep)
-{
-   if(ec) return fail(ec, "connect");
-   LOG_INFO << "websocket connected ";
-
-   // Turn off the timeout on the tcp_stream, because
-   // the websocket stream has its own timeout system.
-   beast::get_lowest_layer(ws_).expires_never();
-
-   // Set suggested timeout settings for the websocket
-   ws_.set_option(
-      websocket::stream_base::timeout::suggested(
-         beast::role_type::client));
-
-   // Set a decorator to change the User-Agent of the handshake
-   ws_.set_option(websocket::stream_base::decorator(
-      [](websocket::request_type& req)
-      {
-         req.set(http::field::user_agent,
-               std::string(BOOST_BEAST_VERSION_STRING) +
-                  " websocket-client-async");
-      }));
-
-   // Update the host_ string. This will provide the value of the
-   // Host HTTP header during the WebSocket handshake.
-   // See https://tools.ietf.org/html/rfc7230#section-5.4
-   host_ += ':' + std::to_string(ep.port());
-
-   // Perform the websocket handshake
-   ws_.async_handshake(host_, target_,
-      beast::bind_front_handler(
-         &websocket_session::on_handshake,
-         shared_from_this()));
-}
-
-void websocket_session::on_handshake(error_code ec)
-{
-   if(ec) return fail(ec, "handshake");
-   LOG_INFO << "websocket handshake successful";
-
-   if (handshakeCallback) handshakeCallback(beast::buffers_to_string(buffer_.data()));
-
-// Clear the buffer
-   buffer_.consume(buffer_.size());
-
-   // read a message when available
-   ws_.async_read(
-      buffer_,
-      beast::bind_front_handler(
-         &websocket_session::on_read,
-         shared_from_this()));
-}
-
-void websocket_session::do_write(std::string message) {
-   if (!write_scheduled){
-
-      std::lock_guard<std::mutex> lock(qmutex);
-      
-      //LOG_DEBUG << "websocket writing message:" << message;
-      // Send the message
-      ws_.async_write(
-         net::buffer(message),
-         beast::bind_front_handler(
-               &websocket_session::on_write,
-               shared_from_this()));
-      write_scheduled = true;
-   } else {
-      //LOG_DEBUG << "websocket queuing message:" << message;
-      message_queue.push(message);
-      if ( verbose_ )
-         LOG_DEBUG << "websocket queuing message. Queue size: " << message_queue.size();
-   }
-}
-
-void websocket_session::on_write(
-      error_code ec,
-      std::size_t bytes_transferred) {
-
-   std::lock_guard<std::mutex> lock(qmutex);
-
-   boost::ignore_unused(bytes_transferred);
-   if(ec) return fail(ec, "write");
-   if ( verbose_ )
-      LOG_DEBUG << "websocket message written: " << bytes_transferred << "bytes. queue size: " << message_queue.size();
-   write_scheduled = false;
-
-   if (!message_queue.empty()){
-      std::string message = message_queue.front();
-      message_queue.pop();
-      if ( verbose_ )
-         LOG_DEBUG << "websocket writing message from queue";
-      // Send the message
-      ws_.async_write(
-         net::buffer(message),
-         beast::bind_front_handler(
-               &websocket_session::on_write,
-               shared_from_this()));
-      write_scheduled = true;
-   }
-}
-
-void websocket_session::registerHandshakeCallback(std::function<void(std::string)> cb)
-{
-   handshakeCallback = std::bind(cb, std::placeholders::_1);
-}
-
-void websocket_session::registerReadCallback(std::function<void(std::string)> cb)
-{
-   readCallback = std::bind(cb, std::placeholders::_1);
-}
-
-void websocket_session::on_read(
-   error_code ec,
-   std::size_t bytes_transferred)
-{
-   boost::ignore_unused(bytes_transferred);
-
-   // errors?
-   if( ec == net::error::eof ) {
-      LOG_ERROR << "read: end-of-file " << ec.message();
-      return;
-   } else if (ec) return fail(ec, "read");
-
-   //LOG_INFO << "read: " << ec.message();
-
-   //LOG_INFO << "websocket message: " << beast::make_printable(buffer_.data());
-   if (readCallback) readCallback(beast::buffers_to_string(buffer_.data()));
-
-   // Clear the buffer
-   buffer_.consume(buffer_.size());
-
-   // read another message when available
-   ws_.async_read(
-      buffer_,
-      beast::bind_front_handler(
-         &websocket_session::on_read,
-         shared_from_this()));
-}
-
-void websocket_session::do_close()
-{
-   // Close the WebSocket connection
-   LOG_INFO << "websocket closing";
-
-   ws_.async_close(websocket::close_code::normal,
-      beast::bind_front_handler(
-         &websocket_session::on_close,
-         shared_from_this()));
-
-}
-
-void websocket_session::on_close(error_code ec)
-{
-   if(ec) return fail(ec, "close");
-
-   // If we get here then the connection is closed gracefully
-   LOG_INFO << "websocket closed gracefully";
-}
-
-void websocket_session::set_verbose(bool flag) {
-   verbose_ = flag;
-}
\ No newline at end of file
+// Copyright (c) 2025 Rainer Leuschke
+// University of Washington, CREST lab
+
+#include <chrono>
+
+#include "amm/BaseLogger.h"
+#include "websocket_session.hpp"
+
+namespace {
+   // permessage_deflate::msg_size_threshold only exists in newer Beast versions
+   template <typename Option>
+   auto set_msg_size_threshold(Option& option, std::size_t threshold, int)
+      -> decltype(option.msg_size_threshold = threshold, bool())
+   {
+      option.msg_size_threshold = threshold;
+      return true;
+   }
+
+   template <typename Option>
+   bool set_msg_size_threshold(Option&, std::size_t, long)
+   {
+      return false;
+   }
+}
+
+websocket_session::websocket_session(net::io_context& ioc, std::size_t queue_size)
+   : ros_session(ioc, queue_size)
+   , ws_(strand_)
+{
+}
+
+websocket_session::~websocket_session()
+{
+}
+
+std::shared_ptr<websocket_session> websocket_session::self()
+{
+   return std::static_pointer_cast<websocket_session>(shared_from_this());
+}
+
+void websocket_session::connect(const tcp::resolver::results_type& results)
+{
+   // Set the timeout for the operation
+   beast::get_lowest_layer(ws_).expires_after(std::chrono::seconds(10));
+
+   // Make the connection on the IP address we get from a lookup
+   beast::get_lowest_layer(ws_).async_connect(
+      results,
+      beast::bind_front_handler(
+         &websocket_session::on_connect,
+         self()));
+}
+
+void websocket_session::on_connect(
+   error_code ec,
+   tcp::resolver::results_type::endpoint_type ep)
+{
+   if(ec) return fail(ec, "connect");
+   LOG_INFO << "websocket connected ";
+   apply_socket_options(beast::get_lowest_layer(ws_).socket());
+
+   // Turn off the timeout on the tcp_stream, because
+   // the websocket stream has its own timeout system.
+   beast::get_lowest_layer(ws_).expires_never();
+
+   // Set suggested timeout settings for the websocket
+   ws_.set_option(
+      websocket::stream_base::timeout::suggested(
+         beast::role_type::client));
+
+   // negotiate compression and frame type before the handshake
+   if (deflate_.client_enable) {
+      if (deflate_threshold_ && !set_msg_size_threshold(deflate_, deflate_threshold_, 0))
+         LOG_WARNING << "websocket deflate threshold not supported by this Beast version";
+      ws_.set_option(deflate_);
+   }
+   ws_.binary(binary_);
+
+   // Set a decorator to change the User-Agent of the handshake
+   ws_.set_option(websocket::stream_base::decorator(
+      [](websocket::request_type& req)
+      {
+         req.set(http::field::user_agent,
+               std::string(BOOST_BEAST_VERSION_STRING) +
+                  " websocket-client-async");
+      }));
+
+   // Update the host_ string. This will provide the value of the
+   // Host HTTP header during the WebSocket handshake.
+   // See https://tools.ietf.org/html/rfc7230#section-5.4
+   host_ += ':' + std::to_string(ep.port());
+
+   // Perform the websocket handshake
+   ws_.async_handshake(host_, target_,
+      beast::bind_front_handler(
+         &websocket_session::on_handshake,
+         self()));
+}
+
+void websocket_session::on_handshake(error_code ec)
+{
+   if(ec) return fail(ec, "handshake");
+   LOG_INFO << "websocket handshake successful";
+
+   opened(beast::buffers_to_string(buffer_.data()));
+
+// Clear the buffer
+   buffer_.consume(buffer_.size());
+
+   // read a message when available
+   ws_.async_read(
+      buffer_,
+      beast::bind_front_handler(
+         &websocket_session::on_read,
+         self()));
+}
+
+// one message per websocket frame
+void websocket_session::write(net::const_buffer data)
+{
+   ws_.async_write(data,
+      [self = self()](error_code ec, std::size_t bytes_transferred) {
+         self->on_write(ec, bytes_transferred);
+      });
+}
+
+void websocket_session::on_read(
+   error_code ec,
+   std::size_t bytes_transferred)
+{
+   boost::ignore_unused(bytes_transferred);
+
+   // errors?
+   if( ec == net::error::eof ) {
+      LOG_ERROR << "read: end-of-file " << ec.message();
+      return closed();
+   } else if (ec) return fail(ec, "read");
+
+   //LOG_INFO << "read: " << ec.message();
+
+   //LOG_INFO << "websocket message: " << beast::make_printable(buffer_.data());
+   if (readCallback) {
+      // terminate the message in the writable area behind it. prepare() may
+      // move the data, so fetch the readable bytes afterwards.
+      net::mutable_buffer terminator = buffer_.prepare(1);
+      static_cast<char*>(terminator.data())[0] = '\0';
+      readCallback(buffer_.data(), ws_.got_binary());
+   }
+
+   // Clear the buffer once the handler is done with it
+   buffer_.consume(buffer_.size());
+
+   // read another message when available
+   ws_.async_read(
+      buffer_,
+      beast::bind_front_handler(
+         &websocket_session::on_read,
+         self()));
+}
+
+bool websocket_session::is_open() const
+{
+   return ws_.is_open();
+}
+
+void websocket_session::cancel()
+{
+   beast::get_lowest_layer(ws_).cancel();
+}
+
+// Close the WebSocket connection. Do not wait long for the server to
+// answer, closing is part of shutdown.
+void websocket_session::shutdown()
+{
+   websocket::stream_base::timeout timeout;
+   ws_.get_option(timeout);
+   timeout.handshake_timeout = std::chrono::seconds(1);
+   ws_.set_option(timeout);
+   ws_.async_close(websocket::close_code::normal,
+      [self = self()](error_code ec) { self->on_close(ec); });
+}
+
+// offer permessage-deflate during the handshake. Call before run().
+void websocket_session::set_deflate(int window_bits, int level, std::size_t threshold) {
+   deflate_.client_enable = true;
+   deflate_.client_max_window_bits = window_bits;
+   deflate_.server_max_window_bits = window_bits;
+   deflate_.compLevel = level;
+   deflate_threshold_ = threshold;
+}
@@ -0,0 +1,73 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+// cbor_reader on untrusted input: nesting, including chains of tags, is
+// bounded, and well formed tagged items still decode.
+
+#include <cstdio>
+#include <string>
+
+#include "cbor.hpp"
+
+namespace {
+
+// counts what the reader reports, accepts everything
+struct counting_handler {
+   int values = 0;
+   bool Null() { ++values; return true; }
+   bool Bool(bool) { ++values; return true; }
+   bool Int(int) { ++values; return true; }
+   bool Uint(unsigned) { ++values; return true; }
+   bool Int64(int64_t) { ++values; return true; }
+   bool Uint64(uint64_t) { ++values; return true; }
+   bool Double(double) { ++values; return true; }
+   bool String(const char*, unsigned, bool) { ++values; return true; }
+   bool Key(const char*, unsigned, bool) { return true; }
+   bool StartObject() { return true; }
+   bool EndObject(unsigned) { return true; }
+   bool StartArray() { return true; }
+   bool EndArray(unsigned) { return true; }
+};
+
+int failures = 0;
+
+void check(bool ok, const char* what)
+{
+   if (!ok) {
+      std::printf("FAIL: %s\n", what);
+      ++failures;
+   }
+}
+
+bool parse(const std::string& data)
+{
+   counting_handler handler;
+   return cbor_parse(data.data(), data.size(), handler);
+}
+
+} // namespace
+
+int main()
+{
+   // tag 0 on the integer 1
+   check(parse(std::string("\xc0\x01", 2)), "single tag");
+
+   // a few chained tags are fine
+   check(parse(std::string(8, '\xc0') + '\x01'), "short tag chain");
+
+   // a long chain of tags must be rejected, not recursed into
+   check(!parse(std::string(1000000, '\xc0') + '\x01'), "long tag chain");
+   check(!parse(std::string(1000000, '\xc0')), "unterminated tag chain");
+
+   // tags between nested arrays count towards the same limit
+   std::string mixed;
+   for (int i = 0; i < 100000; ++i) mixed += "\x81\xc0";
+   mixed += '\x01';
+   check(!parse(mixed), "tags between arrays");
+
+   // nested arrays alone are bounded too
+   check(!parse(std::string(1000000, '\x81') + '\x01'), "deep arrays");
+
+   if (failures == 0) std::printf("cbor_test passed\n");
+   return failures ? 1 : 0;
+}
@@ -0,0 +1,84 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+// message_peek reads the envelope of json and cbor messages. Strings too
+// long for its buffers are kept as well, so a publish on an overlong topic
+// is still routed.
+
+#include <cstdio>
+#include <string>
+
+#include "cbor.hpp"
+#include "message_router.hpp"
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char* what)
+{
+   if (!ok) {
+      std::printf("FAIL: %s\n", what);
+      ++failures;
+   }
+}
+
+std::string json_publish(const std::string& topic)
+{
+   return "{\"op\":\"publish\",\"topic\":\"" + topic + "\",\"msg\":{\"data\":1}}";
+}
+
+std::string cbor_publish(const std::string& topic)
+{
+   std::string out;
+   cbor_writer writer(out);
+   writer.StartObject();
+   writer.Key("op");
+   writer.String("publish");
+   writer.Key("topic");
+   writer.String(topic.data(), (unsigned)topic.size());
+   writer.Key("msg");
+   writer.StartObject();
+   writer.Key("data");
+   writer.Int(1);
+   writer.EndObject();
+   writer.EndObject();
+   return out;
+}
+
+void routes(const std::string& data, bool binary, const message_router& router, int route, const char* what)
+{
+   message_peek peek;
+   check(peek.peek(data.data(), data.size(), binary), what);
+   check(peek.op.is("publish"), what);
+   check(router.route(peek.topic) == route, what);
+}
+
+} // namespace
+
+int main()
+{
+   std::string shortTopic = "/ammRosBridge/short";
+   std::string longTopic = "/ammRosBridge/" + std::string(300, 'x');
+   std::string unknownTopic = "/ammRosBridge/" + std::string(300, 'y');
+
+   message_router router;
+   router.add(shortTopic, [](const rapidjson::Value&) {});
+   router.add(longTopic, [](const rapidjson::Value&) {});
+
+   routes(json_publish(shortTopic), false, router, 0, "json short topic");
+   routes(json_publish(longTopic), false, router, 1, "json overlong topic");
+   routes(json_publish(unknownTopic), false, router, -1, "json overlong unknown topic");
+   routes(cbor_publish(shortTopic), true, router, 0, "cbor short topic");
+   routes(cbor_publish(longTopic), true, router, 1, "cbor overlong topic");
+
+   // an overlong value is present with its full length
+   message_peek peek;
+   std::string data = json_publish(longTopic);
+   peek.peek(data.data(), data.size(), false);
+   check(peek.topic.present && peek.topic.length == longTopic.size() && longTopic == peek.topic.data(),
+         "overlong topic kept");
+
+   if (failures == 0) std::printf("message_router_test passed\n");
+   return failures ? 1 : 0;
+}
@@ -0,0 +1,180 @@
+// AMM ROS Bridge
+// (c) 2025 University of Washington, CREST lab
+
+// ros_session outbound queue: a message written with a coalescing key is
+// sent, or counted as dropped, but never lost to a producer that drops the
+// key's queue entry while another producer rewrites the key. A producer
+// blocked on a full queue sleeps until the writer makes room.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ros_session.hpp"
+
+namespace {
+
+// records the written messages instead of sending them
+class test_session : public ros_session
+{
+public:
+   test_session(net::io_context& ioc, std::size_t queue_size) : ros_session(ioc, queue_size) {}
+
+   std::vector<std::string> written;
+
+protected:
+   const char* transport() const override { return "test"; }
+   void connect(const tcp::resolver::results_type&) override {}
+   void write(net::const_buffer data) override
+   {
+      written.emplace_back((const char*)data.data(), data.size());
+      net::post(strand_, [this, size = data.size()]() { on_write(error_code(), size); });
+   }
+   bool is_open() const override { return true; }
+   void cancel() override {}
+   void shutdown() override {}
+};
+
+int failures = 0;
+
+void check(bool ok, const char* what)
+{
+   if (!ok) {
+      std::printf("FAIL: %s\n", what);
+      ++failures;
+   }
+}
+
+shared_message make(const std::string& data)
+{
+   std::shared_ptr<outbound_message> message = std::make_shared<outbound_message>();
+   message->data = data;
+   return message;
+}
+
+// the io_context is not run while writing, so nothing drains the queue
+// until drain() runs it
+std::vector<std::string> drain(net::io_context& ioc, test_session& session)
+{
+   ioc.restart();
+   ioc.run();
+   std::vector<std::string> written;
+   written.swap(session.written);
+   return written;
+}
+
+std::size_t count(const std::vector<std::string>& written, char prefix)
+{
+   std::size_t n = 0;
+   for (const std::string& data : written)
+      if (!data.empty() && data[0] == prefix) ++n;
+   return n;
+}
+
+// a key written again after it was queued is sent with the newer message,
+// even once its queue entry is the oldest and makes room
+void rewritten_key_survives_drop_oldest()
+{
+   net::io_context ioc;
+   std::shared_ptr<test_session> session = std::make_shared<test_session>(ioc, 4);
+   session->set_queue_policy(queue_policy::drop_oldest);
+   int key = session->coalesce_key("/key");
+   std::size_t capacity = session->stats().capacity;
+
+   session->do_write(make("k1"), key);
+   session->do_write(make("k2"), key);
+   for (std::size_t i = 0; i < capacity + 1; ++i)
+      session->do_write(make("f" + std::to_string(i)));
+
+   std::vector<std::string> written = drain(ioc, *session);
+   check(count(written, 'k') == 1, "rewritten key sent once");
+   check(std::find(written.begin(), written.end(), "k2") != written.end(),
+         "rewritten key sent with the newer message");
+}
+
+// two threads write the same key while the queue is full of other messages
+void same_key_against_full_queue(queue_policy policy, const char* what)
+{
+   const int writes = 20000;
+   net::io_context ioc;
+   std::shared_ptr<test_session> session = std::make_shared<test_session>(ioc, 4);
+   session->set_queue_policy(policy);
+   int key = session->coalesce_key("/key");
+   std::size_t capacity = session->stats().capacity;
+
+   std::vector<std::thread> producers;
+   for (int t = 0; t < 2; ++t) {
+      producers.emplace_back([&, t]() {
+         for (int i = 0; i < writes; ++i) {
+            // keep the queue full
+            if (i % 8 == 0)
+               for (std::size_t f = 0; f < capacity; ++f) session->do_write(make("f"));
+            session->do_write(make("k" + std::to_string(t) + ":" + std::to_string(i)), key);
+         }
+      });
+   }
+   for (std::thread& producer : producers) producer.join();
+
+   // drop_oldest never refuses a message: the key was queued last by one
+   // of the threads and is sent. drop_newest may have refused it.
+   std::vector<std::string> written = drain(ioc, *session);
+   std::size_t sent = count(written, 'k');
+   check(sent <= 1, what);
+   if (policy == queue_policy::drop_oldest) check(sent == 1, what);
+
+   // every message is sent, coalesced or counted as dropped
+   std::size_t fillers = (writes + 7) / 8 * capacity;
+   queue_stats stats = session->stats();
+   check(stats.written + stats.coalesced + stats.dropped_oldest + stats.dropped_newest >=
+         (writes + fillers) * 2, what);
+
+   // the key slot was left empty, so the key is queued and sent again
+   session->do_write(make("k-last"), key);
+   written = drain(ioc, *session);
+   check(written.size() == 1 && written[0] == "k-last", what);
+}
+
+// a producer blocked on a full queue is woken once the writer makes room
+void block_waits_for_room()
+{
+   net::io_context ioc;
+   std::shared_ptr<test_session> session = std::make_shared<test_session>(ioc, 4);
+   session->set_queue_policy(queue_policy::block);
+   std::size_t capacity = session->stats().capacity;
+   for (std::size_t i = 0; i < capacity; ++i) session->do_write(make("f"));
+
+   std::atomic<bool> done{false};
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+   std::thread producer([&]() {
+      session->do_write(make("b"));
+      done = true;
+   });
+   std::this_thread::sleep_for(std::chrono::milliseconds(50));
+   check(!done, "block waits while the queue is full");
+
+   std::vector<std::string> written = drain(ioc, *session);
+   producer.join();
+   check(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500), "block woken by the writer");
+   std::vector<std::string> rest = drain(ioc, *session);
+   written.insert(written.end(), rest.begin(), rest.end());
+   check(written.size() == capacity + 1 && written.back() == "b", "blocked message sent");
+   check(session->stats().dropped_newest == 0, "blocked message not dropped");
+}
+
+} // namespace
+
+int main()
+{
+   rewritten_key_survives_drop_oldest();
+   same_key_against_full_queue(queue_policy::drop_newest, "same key, drop newest");
+   same_key_against_full_queue(queue_policy::drop_oldest, "same key, drop oldest");
+   block_waits_for_room();
+
+   if (failures == 0) std::printf("ros_session_test passed\n");
+   return failures ? 1 : 0;
+}